@@ -0,0 +1,132 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+// Standalone micro-benchmarks of the routing table hot functions using
+// synthetic neighbor tables, no simulation kernel required.
+// Build and run with `make run` in this directory.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+
+#include "common/OrderedDropHeadQueue.h"
+#include "networklayer/RoutingAlgorithms.h"
+
+using namespace oppostack;
+
+static size_t allocationCount = 0;
+
+void* operator new(std::size_t size)
+{
+    allocationCount++;
+    if(void* ptr = std::malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+// Mirrors ORWRoutingTable::NeighborEntry with plain double costs
+struct NeighborEntry {
+    double lastEqDC = 25.5;
+    double recentInteractionProb = 0;
+    double interactionsTotal = 0;
+};
+typedef uint32_t Address;
+typedef std::map<Address, NeighborEntry> NeighbourRecords;
+
+// Mirrors PacketRecord from EncounterDetails.msg
+struct PacketRecord {
+    Address source = 0;
+    unsigned int seqNo = 0;
+    bool operator ==(const PacketRecord& b) const { return source == b.source && seqNo == b.seqNo; }
+};
+
+NeighbourRecords makeTable(int entries, std::mt19937& rng, Address offset)
+{
+    std::uniform_real_distribution<double> cost(0.0, 25.5);
+    std::uniform_real_distribution<double> prob(0.0, 1.0);
+    NeighbourRecords table;
+    for(int i = 0; i < entries; i++){
+        NeighborEntry entry;
+        entry.lastEqDC = (int)(cost(rng) * 10) / 10.0; // ExpectedCost resolution
+        // A quarter of the entries are inactive
+        entry.recentInteractionProb = prob(rng) < 0.25 ? 0.0 : prob(rng) / entries;
+        entry.interactionsTotal = (int)(prob(rng) * 4);
+        table[offset + i * 2] = entry;
+    }
+    return table;
+}
+
+volatile double sink; // Defeats dead code elimination of benchmark results
+
+void report(const char* name, int entries, const std::function<void()>& op)
+{
+    // Calibrate the iterations to at least 100ms of work
+    long iterations = 1;
+    double elapsed = 0;
+    size_t allocations = 0;
+    while(true){
+        const size_t startAllocations = allocationCount;
+        const auto start = std::chrono::steady_clock::now();
+        for(long i = 0; i < iterations; i++){
+            op();
+        }
+        elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        allocations = allocationCount - startAllocations;
+        if(elapsed > 1e8 || iterations > (1L << 30))break;
+        iterations *= 2;
+    }
+    std::printf("%-28s %7d %14.1f %12.2f\n", name, entries, elapsed / iterations, (double)allocations / iterations);
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::printf("%-28s %7s %14s %12s\n", "function", "entries", "ns/op", "allocs/op");
+    for(int entries : {10, 100, 1000, 10000}){
+        const NeighbourRecords encounters = makeTable(entries, rng, 0);
+        // Half the routing set overlaps with direct neighbors
+        const NeighbourRecords routingSet = makeTable(entries, rng, entries);
+        routing::CostProbabilityPairs<double> pairs;
+        const double ownCost = routing::costToRoot(encounters, [](){return 15.0;}, 25.5, pairs);
+        std::uniform_int_distribution<Address> destination(0, 3 * entries);
+
+        report("calculateCostToRoot", entries, [&](){
+            sink = routing::costToRoot(encounters, [](){return 15.0;}, 25.5, pairs);
+        });
+        report("calculateDownwardsCost", entries, [&](){
+            sink = routing::downwardsCost(routingSet, encounters, destination(rng), ownCost, 0.1, 25.5);
+        });
+        report("countDownwardNodes", entries, [&](){
+            sink = routing::countDownwardNodes(routingSet, encounters, ownCost);
+        });
+        report("getSharingRoutingSet", entries, [&](){
+            std::set<Address> sharing;
+            std::set<Address> excluded;
+            auto isDownwards = [&](const double cost){return cost >= ownCost + 0.1;};
+            sink = routing::sharingRoutingSet(routingSet, encounters, isDownwards, sharing, excluded);
+        });
+
+        OrderedDropHeadQueue<PacketRecord> history(entries);
+        for(int i = 0; i < entries; i++){
+            history.insert(PacketRecord{(Address)i % 50, (unsigned int)i});
+        }
+        std::uniform_int_distribution<unsigned int> seqNo(0, 2 * entries);
+        report("OrderedDropHeadQueue::find", entries, [&](){
+            const unsigned int seq = seqNo(rng);
+            sink = history.find(PacketRecord{seq % 50, seq});
+        });
+    }
+    return 0;
+}
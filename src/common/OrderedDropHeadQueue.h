@@ -0,0 +1,47 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef COMMON_ORDEREDDROPHEADQUEUE_H_
+#define COMMON_ORDEREDDROPHEADQUEUE_H_
+
+#include <algorithm> // For std::find
+#include <deque>
+
+namespace oppostack{
+
+// Bounded history of elements in insertion order, re-inserting an element
+// moves it to the back. Free of simulation kernel dependencies so it can be
+// exercised by the standalone benchmarks.
+template <class T>
+class OrderedDropHeadQueue{
+private:
+    std::deque<T> q;
+    unsigned int maxSize;
+public:
+    OrderedDropHeadQueue(int _size = 64):
+        q(_size), maxSize(_size){}
+
+    const typename std::deque<T>::const_iterator getIndex(const T& element) const{
+        return std::find(q.begin(),q.end(),element);
+    }
+    bool find(const T& element) const{
+        return getIndex(element) != q.end();
+    }
+
+    void insert(const T& element){
+        auto duplicate = getIndex(element);
+        if(duplicate!=q.end()){
+            q.erase(duplicate);
+        }
+        while(q.size()>=maxSize){
+            q.pop_front();
+        }
+        q.push_back(element);
+    }
+};
+
+} //namespace oppostack
+
+#endif /* COMMON_ORDEREDDROPHEADQUEUE_H_ */
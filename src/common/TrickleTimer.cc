@@ -0,0 +1,75 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "TrickleTimer.h"
+
+using namespace omnetpp;
+using namespace oppostack;
+
+TrickleTimer::TrickleTimer(cSimpleModule* parent, simtime_t minInterval, int doublings, int redundancyConstant):
+        parent(parent),
+        intervalTimer(new cMessage("trickle interval")),
+        transmitTimer(new cMessage("trickle transmit")),
+        minInterval(minInterval),
+        maxInterval(minInterval * (1 << doublings)),
+        redundancyConstant(redundancyConstant),
+        interval(minInterval)
+{
+    ASSERT(minInterval > 0);
+    ASSERT(doublings >= 0 && doublings < 31);
+    ASSERT(redundancyConstant > 0);
+}
+
+TrickleTimer::~TrickleTimer()
+{
+    stop();
+    delete intervalTimer;
+    delete transmitTimer;
+}
+
+void TrickleTimer::startInterval()
+{
+    consistentCount = 0;
+    parent->cancelEvent(intervalTimer);
+    parent->cancelEvent(transmitTimer);
+    // Transmit in the second half of the interval so that listen-only time is guaranteed
+    parent->scheduleAt(simTime() + parent->uniform(interval / 2, interval), transmitTimer);
+    parent->scheduleAt(simTime() + interval, intervalTimer);
+}
+
+void TrickleTimer::start()
+{
+    interval = minInterval;
+    startInterval();
+}
+
+void TrickleTimer::stop()
+{
+    parent->cancelEvent(intervalTimer);
+    parent->cancelEvent(transmitTimer);
+}
+
+bool TrickleTimer::reset()
+{
+    if(!isRunning() || interval == minInterval){
+        return false;
+    }
+    interval = minInterval;
+    startInterval();
+    return true;
+}
+
+TrickleTimer::Event TrickleTimer::handleTimer(cMessage* msg)
+{
+    if(msg == transmitTimer){
+        return consistentCount < redundancyConstant ? Event::TRANSMIT : Event::SUPPRESS;
+    }
+    else if(msg == intervalTimer){
+        interval = std::min(interval * 2, maxInterval);
+        startInterval();
+        return Event::INTERVAL_END;
+    }
+    return Event::NONE;
+}
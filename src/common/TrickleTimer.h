@@ -0,0 +1,61 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef COMMON_TRICKLETIMER_H_
+#define COMMON_TRICKLETIMER_H_
+
+#include <omnetpp.h>
+
+namespace oppostack {
+
+/**
+ * Trickle algorithm (RFC 6206) for rate limiting consistent state advertisement.
+ * The interval doubles from minInterval up to minInterval*2^doublings while the
+ * neighborhood is consistent, a transmission in each interval is suppressed once
+ * redundancyConstant consistent transmissions have been heard.
+ * Timers are scheduled on, and must be passed back from, the parent module.
+ */
+class TrickleTimer
+{
+  public:
+    enum class Event {
+        NONE,
+        TRANSMIT,
+        SUPPRESS,
+        INTERVAL_END
+    };
+  protected:
+    omnetpp::cSimpleModule* parent;
+    omnetpp::cMessage* intervalTimer;
+    omnetpp::cMessage* transmitTimer;
+    const omnetpp::simtime_t minInterval;
+    const omnetpp::simtime_t maxInterval;
+    const int redundancyConstant;
+    omnetpp::simtime_t interval;
+    int consistentCount{0};
+
+    void startInterval();
+  public:
+    TrickleTimer(omnetpp::cSimpleModule* parent, omnetpp::simtime_t minInterval, int doublings, int redundancyConstant);
+    virtual ~TrickleTimer();
+
+    bool isTrickleTimer(const omnetpp::cMessage* msg) const{
+        return msg == intervalTimer || msg == transmitTimer;};
+    bool isRunning() const{return intervalTimer->isScheduled();}
+    bool isAtMaxInterval() const{return interval >= maxInterval;}
+    omnetpp::simtime_t getInterval() const{return interval;}
+
+    // Begin with the minimum interval
+    void start();
+    void stop();
+    // Inconsistency heard, returns true if the interval was shortened
+    bool reset();
+    void hearConsistent(){consistentCount++;}
+    Event handleTimer(omnetpp::cMessage* msg);
+};
+
+} /* namespace oppostack */
+
+#endif /* COMMON_TRICKLETIMER_H_ */
@@ -0,0 +1,164 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "ORWLplMac.h"
+#include <inet/physicallayer/wireless/common/contract/packetlevel/IRadio.h>
+
+using namespace inet;
+using physicallayer::IRadio;
+using namespace oppostack;
+
+Define_Module(ORWLplMac);
+
+simsignal_t ORWLplMac::channelCheckSignal = cComponent::registerSignal("channelCheck");
+simsignal_t ORWLplMac::strobeLengthSignal = cComponent::registerSignal("strobeLength");
+
+void ORWLplMac::initialize(int stage)
+{
+    ORWMac::initialize(stage);
+    if(stage == INITSTAGE_LOCAL){
+        channelCheckTimer = new cMessage("channel check timer");
+        checkInterval = par("checkInterval");
+        checkDuration = par("checkDuration");
+        strobeDuration = par("strobeDuration");
+        if(checkInterval <= checkDuration)
+            throw cRuntimeError("checkInterval must be longer than checkDuration");
+        // A listener must hear part of a strobe frame in the gap between two frames
+        if(checkDuration <= ackWaitDuration + initialContentionDuration)
+            EV_WARN << "checkDuration is shorter than the gap between strobe frames, receivers may miss strobes" << endl;
+        if(strobeDuration < checkInterval)
+            EV_WARN << "strobeDuration is shorter than checkInterval, sleeping forwarders may miss strobes" << endl;
+    }
+}
+
+void ORWLplMac::handleSelfMessage(cMessage* const msg)
+{
+    if(msg == channelCheckTimer){
+        scheduleAt(simTime() + checkInterval, channelCheckTimer);
+        if(macState == State::DATA_IDLE && !channelCheckListening
+                && dataRadio->getRadioMode() == IRadio::RADIO_MODE_SLEEP){
+            // Wake the data radio to sample the channel
+            channelCheckListening = true;
+            channelCheckExtended = false;
+            dataRadio->setRadioMode(IRadio::RADIO_MODE_RECEIVER);
+        }
+    }
+    else{
+        ORWMac::handleSelfMessage(msg);
+    }
+}
+
+void ORWLplMac::cancelAllTimers()
+{
+    ORWMac::cancelAllTimers();
+    if(channelCheckTimer != nullptr)
+        cancelEvent(channelCheckTimer);
+    channelCheckListening = false;
+}
+
+void ORWLplMac::handleStartOperation(LifecycleOperation* const operation)
+{
+    ORWMac::handleStartOperation(operation);
+    // Random phase so neighbors do not check the channel together
+    cancelEvent(channelCheckTimer);
+    scheduleAt(simTime() + uniform(0, checkInterval), channelCheckTimer);
+}
+
+void ORWLplMac::stateProcess(const MacEvent& event, cMessage* const msg)
+{
+    if(macState == State::DATA_IDLE && channelCheckListening){
+        if(event == MacEvent::DATA_RX_READY){
+            // Radio listening, sample the channel
+            scheduleAt(simTime() + checkDuration, receiveTimeout);
+            return;
+        }
+        else if(event == MacEvent::DATA_TIMEOUT){
+            if(receptionState != IRadio::RECEPTION_STATE_IDLE && !channelCheckExtended){
+                // Activity heard, listen long enough for the next repeat of the frame
+                channelCheckExtended = true;
+                scheduleAt(simTime() + dataListeningDuration, receiveTimeout);
+            }
+            else{
+                emit(channelCheckSignal, channelCheckExtended);
+                stateChannelCheckExit();
+            }
+            return;
+        }
+        else if(event == MacEvent::DATA_RECEIVED || event == MacEvent::QUEUE_SEND){
+            // Hand over to the ORWMac reception or transmission
+            emit(channelCheckSignal, true);
+            cancelEvent(receiveTimeout);
+            channelCheckListening = false;
+        }
+    }
+    else if(macState == State::AWAIT_TRANSMIT && event == MacEvent::DATA_RX_IDLE){
+        // Queued as the radio went to sleep, listen again for the carrier sense
+        dataRadio->setRadioMode(IRadio::RADIO_MODE_RECEIVER);
+        return;
+    }
+    ORWMac::stateProcess(event, msg);
+}
+
+void ORWLplMac::stateChannelCheckExit()
+{
+    channelCheckListening = false;
+    dataRadio->setRadioMode(IRadio::RADIO_MODE_SLEEP);
+}
+
+ORWMac::State ORWLplMac::stateListeningEnter()
+{
+    if(currentTxFrame || not txQueue->isEmpty()){
+        // Stay listening for carrier sense before the transmission
+        return ORWMac::stateListeningEnter();
+    }
+    // Sleep until the next channel check
+    channelCheckListening = false;
+    dataRadio->setRadioMode(IRadio::RADIO_MODE_SLEEP);
+    return State::DATA_IDLE;
+}
+
+ORWMac::State ORWLplMac::stateTxEnter()
+{
+    strobing = true;
+    strobeFrames = 1;
+    strobeEnd = simTime() + strobeDuration;
+    return ORWMac::stateTxEnter();
+}
+
+bool ORWLplMac::stateTxProcess(const MacEvent& event, cMessage* const msg)
+{
+    if(txDataState == TxDataState::ACK_WAIT && event == MacEvent::ACK_TIMEOUT && strobing
+            && acknowledgedForwarders == 0 && dataRadio->getReceptionState() == IRadio::RECEPTION_STATE_IDLE){
+        if(simTime() < strobeEnd){
+            // No forwarder awake yet, repeat the data frame
+            // The next acknowledged frame is the first ack round for the forwarders
+            strobeFrames++;
+            acknowledgmentRound = 0;
+            stateTxEnterDataWait();
+            return false;
+        }
+        stateTxEndStrobe();
+    }
+    return ORWMac::stateTxProcess(event, msg);
+}
+
+void ORWLplMac::handleForwarderAck(const Packet* const ack)
+{
+    if(strobing){
+        stateTxEndStrobe();
+    }
+    ORWMac::handleForwarderAck(ack);
+}
+
+void ORWLplMac::stateTxEndStrobe()
+{
+    strobing = false;
+    emit(strobeLengthSignal, strobeFrames);
+}
+
+ORWLplMac::~ORWLplMac()
+{
+    cancelAndDelete(channelCheckTimer);
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef LINKLAYER_ORWLPLMAC_H_
+#define LINKLAYER_ORWLPLMAC_H_
+
+#include <omnetpp.h>
+
+#include "ORWMac.h"
+
+namespace oppostack {
+
+/**
+ * ORWLplMac - Low power listening variant of ORWMac for nodes without a
+ * wake-up radio. The data radio sleeps while idle and periodically listens
+ * for channel activity, transmitters repeat the data frame (strobe) until
+ * a forwarder acknowledges it.
+ */
+class ORWLplMac : public ORWMac
+{
+  public:
+    ~ORWLplMac();
+
+  protected:
+    /** @brief User Configured parameters */
+    omnetpp::simtime_t checkInterval{0};
+    omnetpp::simtime_t checkDuration{0};
+    omnetpp::simtime_t strobeDuration{0};
+
+    /** @name Channel check (receiver) */
+    /*@{*/
+    omnetpp::cMessage* channelCheckTimer{nullptr};
+    bool channelCheckListening{false};
+    bool channelCheckExtended{false};
+    void stateChannelCheckExit();
+    static omnetpp::simsignal_t channelCheckSignal;
+    /*@}*/
+
+    /** @name Strobe (transmitter) */
+    /*@{*/
+    bool strobing{false};
+    omnetpp::simtime_t strobeEnd{0};
+    int strobeFrames{0};
+    void stateTxEndStrobe();
+    static omnetpp::simsignal_t strobeLengthSignal;
+    /*@}*/
+
+    virtual void initialize(int stage) override;
+    virtual void handleSelfMessage(omnetpp::cMessage* msg) override;
+    virtual void cancelAllTimers() override;
+    virtual void handleStartOperation(inet::LifecycleOperation *operation) override;
+
+    virtual void stateProcess(const MacEvent& event, omnetpp::cMessage* msg) override;
+    virtual State stateListeningEnter() override;
+    virtual State stateTxEnter() override;
+    virtual bool stateTxProcess(const MacEvent& event, omnetpp::cMessage* msg) override;
+    virtual void handleForwarderAck(const inet::Packet* ack) override;
+};
+
+} /* namespace oppostack */
+
+#endif /* LINKLAYER_ORWLPLMAC_H_ */
@@ -20,6 +20,9 @@
 #include <inet/common/ProtocolGroup.h>
 #include "common/EqDCTag_m.h"
 #include "common/EncounterDetails_m.h"
+#ifdef OPPOSTACK_DELAY_TRACKING
+#include "statistics/PacketDelayTag_m.h"
+#endif
 
 using namespace oppostack;
 using namespace inet;
@@ -28,6 +31,11 @@ using physicallayer::FlatTransmitterBase;
 
 Define_Module(ORWMac);
 
+simsignal_t ORWMac::forwardingEnergyHeadroomSignal = cComponent::registerSignal("forwardingEnergyHeadroom");
+simsignal_t ORWMac::congestedForwarderAckSignal = cComponent::registerSignal("congestedForwarderAck");
+simsignal_t ORWMac::congestionBackoffSignal = cComponent::registerSignal("congestionBackoff");
+simsignal_t ORWMac::successfulTransmissionTriesSignal = cComponent::registerSignal("successfulTransmissionTries");
+
 void ORWMac::initialize(int stage) {
     MacProtocolBase::initialize(stage);
     if (stage == INITSTAGE_LOCAL) {
@@ -43,6 +51,21 @@ void ORWMac::initialize(int stage) {
         ackWaitDuration = par("ackWaitDuration");
         initialContentionDuration = ackWaitDuration/3;
         candiateRelayContentionProbability = par("candiateRelayContentionProbability");
+        energyAwareForwarding = par("energyAwareForwarding");
+        energyAwareContentionBias = par("energyAwareContentionBias");
+        fragmentBurst = par("fragmentBurst");
+        congestionBackpressure = par("congestionBackpressure");
+        congestionThreshold = par("congestionThreshold");
+        congestionHoldDuration = par("congestionHoldDuration");
+        congestionBackoff = par("congestionBackoff");
+        forwarderWideningStep = EqDC(par("forwarderWideningStep"));
+        retryBackoff = par("retryBackoff");
+        if(forwarderWideningStep < EqDC(0))
+            throw cRuntimeError("forwarderWideningStep must not be negative");
+        if(congestionThreshold < 0 || congestionThreshold > 1)
+            throw cRuntimeError("congestionThreshold must be between 0 and 1");
+        if(energyAwareContentionBias < 0 || energyAwareContentionBias > 1)
+            throw cRuntimeError("energyAwareContentionBias must be between 0 and 1");
 
         // link direct module interfaces
         const char* energyStoragePath = par("energyStorage");
@@ -127,7 +150,9 @@ void ORWMac::initialize(int stage) {
 void ORWMac::configureNetworkInterface() {
     // generate a link-layer address to be used as interface token for IPv6
     auto lengthPrototype = makeShared<ORWDatagram>();
-    const B interfaceMtu = phyMtu-B(lengthPrototype->getChunkLength());
+    // Fragment bursts add the sequence number byte
+    const B sequenceNumberLength = par("fragmentBurst").boolValue() ? B(1) : B(0);
+    const B interfaceMtu = phyMtu-B(lengthPrototype->getChunkLength())-sequenceNumberLength;
     ASSERT2(interfaceMtu >= B(80), "The interface MTU available to the net layer is too small (under 80 bytes)");
     networkInterface->setMtu(interfaceMtu.get());
     networkInterface->setMulticast(true);
@@ -170,6 +195,10 @@ void ORWMac::handleUpperPacket(Packet* const packet) {
     }
     if(addressRequest->getDestAddress() == MacAddress::BROADCAST_ADDRESS)
         packet->addTagIfAbsent<EqDCBroadcast>();
+    updateOwnCostInd(packet);
+#ifdef OPPOSTACK_DELAY_TRACKING
+    packet->addTagIfAbsent<MacTimingInd>()->setMacArrival(simTime());
+#endif
     txQueue->enqueuePacket(packet);
     stateProcess(MacEvent::QUEUE_SEND, packet);
 }
@@ -287,13 +316,16 @@ void ORWMac::setupTransmission() {
         dropCurrentTxFrame(details);
     }
     currentTxFrame = dequeuePacket();
+    txSequenceNumber++;
+    congestedForwarderCost = ExpectedCost(255);
+    uncongestedForwarderCost = ExpectedCost(255);
     if(datagramLocalOutHook(currentTxFrame)!=INetfilter::IHook::Result::ACCEPT){
         throw cRuntimeError("Unhandled rejection of packet at transmission setup");
     }
 }
 
 void ORWMac::setBeaconFieldsFromTags(const Packet* subject,
-        const inet::Ptr<ORWBeacon>& wuHeader) const
+        const inet::Ptr<ORWBeacon>& wuHeader, const int retryCount) const
 {
     const auto equivalentDCTag = subject->findTag<EqDCReq>();
     const auto equivalentDCInd = subject->findTag<EqDCInd>();
@@ -303,9 +335,21 @@ void ORWMac::setBeaconFieldsFromTags(const Packet* subject,
     if(equivalentDCTag == nullptr && macAddressTag->getDestAddress() != MacAddress::BROADCAST_ADDRESS){
         minExpectedCost = EqDC(0);
     }
-    else if (equivalentDCTag != nullptr && equivalentDCTag->getEqDC() < minExpectedCost) {
-        minExpectedCost = equivalentDCTag->getEqDC();
-        ASSERT(minExpectedCost >= ExpectedCost(0));
+    else if (equivalentDCTag != nullptr) {
+        EqDC requiredCost = equivalentDCTag->getEqDC();
+        if(retryCount > 0 && forwarderWideningStep > EqDC(0) && requiredCost < equivalentDCInd->getEqDC()){
+            // Admit costlier forwarders on each retry, never ones costlier than this node
+            requiredCost = std::min(requiredCost + forwarderWideningStep*(double)retryCount, equivalentDCInd->getEqDC());
+        }
+        if(requiredCost < minExpectedCost){
+            minExpectedCost = requiredCost;
+            ASSERT(minExpectedCost >= ExpectedCost(0));
+        }
+    }
+    if(congestionBackpressure && simTime() < congestionExcludedUntil && congestionExcludedCost < minExpectedCost
+            && equivalentDCTag != nullptr){
+        // Leave out congested forwarders while a cheaper one is known to have space
+        minExpectedCost = congestionExcludedCost;
     }
     wuHeader->setMinExpectedCost(minExpectedCost);
     wuHeader->setExpectedCostInd(equivalentDCInd->getEqDC());
@@ -315,22 +359,41 @@ void ORWMac::setBeaconFieldsFromTags(const Packet* subject,
 
 void ORWMac::encapsulate(Packet* const pkt) const{ // From CsmaCaMac
     auto macHeader = makeShared<ORWDatagram>();
-    setBeaconFieldsFromTags(pkt, macHeader);
+    setBeaconFieldsFromTags(pkt, macHeader, txInProgressTries - 1);
     const auto upwardsTag = pkt->findTag<EqDCUpwards>();
     if(upwardsTag != nullptr){
         macHeader->setUpwards(upwardsTag->isUpwards());
     }
+    if(fragmentBurst){
+        macHeader->setSequenceNumber(txSequenceNumber);
+        macHeader->setFramePending(isNextFragmentQueued(pkt));
+        macHeader->setChunkLength(macHeader->getChunkLength() + B(1));
+    }
 
     pkt->insertAtFront(macHeader);
     pkt->addTagIfAbsent<PacketProtocolTag>()->setProtocol(&ORWProtocol);
 }
 
+bool ORWMac::isNextFragmentQueued(const Packet* const frame) const
+{
+    if(frame->findTag<FramePendingReq>() == nullptr || txQueue->isEmpty()){
+        return false;
+    }
+    // An unrelated packet at the head of the queue must not join the burst
+    const auto current = frame->findTag<FragmentReq>();
+    const auto next = txQueue->getPacket(0)->findTag<FragmentReq>();
+    return current != nullptr && next != nullptr && next->getSource() == current->getSource()
+            && next->getDatagramId() == current->getDatagramId()
+            && next->getFragmentIndex() == current->getFragmentIndex() + 1;
+}
+
 void ORWMac::completePacketTransmission()
 {
     emit(ackContentionRoundsSignal, acknowledgmentRound);
     bool sufficientForwarders = txInProgressForwarders >= requiredForwarders
             || currentTxFrame->findTag<EqDCBroadcast>();
     if (sufficientForwarders) {
+        emit(successfulTransmissionTriesSignal, txInProgressTries);
         deleteCurrentTxFrame();
         emit(transmissionEndedSignal, true);
     }
@@ -345,6 +408,15 @@ void ORWMac::completePacketTransmission()
     }
 }
 
+simtime_t ORWMac::retryDelay() const
+{
+    if(retryBackoff == 0){
+        return ackWaitDuration;
+    }
+    // Grows with each try, random so senders that failed together do not retry together
+    return ackWaitDuration + uniform(0, retryBackoff.dbl()*txInProgressTries);
+}
+
 void ORWMac::decapsulate(Packet* const pkt) const{ // From CsmaCaMac
     auto macHeader = pkt->popAtFront<ORWDatagram>();
     auto addressInd = pkt->addTagIfAbsent<MacAddressInd>();
@@ -367,6 +439,14 @@ Packet* ORWMac::buildAck(const Packet* receivedFrame) const{
         ackPacket->setExpectedCostInd(costIndTag->getEqDC());
     else
         cRuntimeError("ORWMac must respond with a cost");
+    if(energyAwareForwarding){
+        ackPacket->setEnergyHeadroom(std::lround(calculateEnergyHeadroom()*255));
+        ackPacket->setChunkLength(ackPacket->getChunkLength() + B(1));
+    }
+    if(congestionBackpressure){
+        ackPacket->setQueueState(calculateQueueState());
+        ackPacket->setChunkLength(ackPacket->getChunkLength() + B(1));
+    }
     auto frame = new Packet("ORWAck");
     frame->insertAtFront(ackPacket);
     frame->addTagIfAbsent<PacketProtocolTag>()->setProtocol(&ORWProtocol);
@@ -398,6 +478,99 @@ void ORWMac::handleOverheardAckInDataReceiveState(const Packet * const msg){
     if(rxAckRound<=1){
         emitEncounterFromWeightedPacket(coincidentalEncounterSignal, 1.0, msg);
     }
+    if(energyAwareForwarding){
+        const double headroom = msg->peekAtFront<ORWAck>()->getEnergyHeadroom()/255.0;
+        maxOverheardHeadroom = std::max(maxOverheardHeadroom, headroom);
+    }
+}
+
+double ORWMac::relayContentionProbability() const
+{
+    if(!energyAwareForwarding){
+        return candiateRelayContentionProbability;
+    }
+    // Give way to competing forwarders that advertised more energy headroom
+    const double deficit = std::max(0.0, maxOverheardHeadroom - calculateEnergyHeadroom());
+    return candiateRelayContentionProbability * (1 - energyAwareContentionBias*deficit);
+}
+
+double ORWMac::calculateEnergyHeadroom() const
+{
+    const J nominalCapacity = energyStorage->getNominalEnergyCapacity();
+    if(nominalCapacity <= transmissionStartMinEnergy){
+        return 1.0;
+    }
+    const J residualCapacity = energyStorage->getResidualEnergyCapacity();
+    const double headroom = unit((residualCapacity - transmissionStartMinEnergy)/(nominalCapacity - transmissionStartMinEnergy)).get();
+    return std::min(std::max(headroom, 0.0), 1.0);
+}
+
+uint8_t ORWMac::calculateQueueState() const
+{
+    // The received packet will join the queue, so a full queue pushes a packet out
+    const int capacity = txQueue->getMaxNumPackets();
+    if(capacity <= 0){
+        return 0;
+    }
+    const double occupancy = (double)(txQueue->getNumPackets() + 1)/capacity;
+    return std::lround(std::min(occupancy, 1.0)*255);
+}
+
+void ORWMac::handleForwarderAck(const Packet* const ack)
+{
+    if(!congestionBackpressure){
+        return;
+    }
+    auto ackHeader = ack->peekAtFront<ORWAck>();
+    const ExpectedCost forwarderCost = ackHeader->getExpectedCostInd();
+    if(ackHeader->getQueueState() >= congestionThreshold*255){
+        emit(congestedForwarderAckSignal, (long)ackHeader->getQueueState());
+        congestedForwarderCost = std::min(congestedForwarderCost, forwarderCost);
+    }
+    else{
+        uncongestedForwarderCost = std::min(uncongestedForwarderCost, forwarderCost);
+    }
+}
+
+void ORWMac::updateCongestionExclusion()
+{
+    if(!congestionBackpressure || congestedForwarderCost == ExpectedCost(255)){
+        return;
+    }
+    if(uncongestedForwarderCost < congestedForwarderCost){
+        // Only forwarders cheaper than the congested one are asked in the next rounds
+        congestionExcludedCost = congestedForwarderCost - ExpectedCost(1);
+        congestionExcludedUntil = simTime() + congestionHoldDuration;
+    }
+}
+
+void ORWMac::endTransmissionCongestionCheck()
+{
+    if(!congestionBackpressure || congestedForwarderCost == ExpectedCost(255)
+            || uncongestedForwarderCost < ExpectedCost(255)){
+        return;
+    }
+    // Every forwarder that acknowledged is congested, hold back the next transmission
+    congestionHoldUntil = simTime() + congestionBackoff;
+    emit(congestionBackoffSignal, congestionBackoff);
+}
+
+INetfilter::IHook::Result ORWMac::datagramPreRoutingHook(Packet* datagram)
+{
+    if(energyAwareForwarding){
+        datagram->addTagIfAbsent<EnergyHeadroomInd>()->setHeadroom(calculateEnergyHeadroom());
+    }
+    const auto result = IOpportunisticLinkLayer::datagramPreRoutingHook(datagram);
+    updateOwnCostInd(datagram);
+    return result;
+}
+
+void ORWMac::updateOwnCostInd(const Packet* const packet)
+{
+    const auto costInd = packet->findTag<EqDCInd>();
+    if(costInd != nullptr){
+        ownCostInd = costInd->getEqDC();
+    }
 }
 
 void ORWMac::completePacketReception()
@@ -409,6 +582,12 @@ void ORWMac::completePacketReception()
         pkt->removeTagIfPresent<EqDCReq>();
         pkt->removeTagIfPresent<EqDCInd>();
         pkt->trim();
+#ifdef OPPOSTACK_DELAY_TRACKING
+        pkt->addTagIfAbsent<MacTimingInd>()->setAckRounds(rxAckRound);
+#endif
+        if(energyAwareForwarding){
+            emit(forwardingEnergyHeadroomSignal, calculateEnergyHeadroom());
+        }
         if(datagramLocalInHook(pkt)!=IHook::Result::ACCEPT){
             EV_ERROR << "Aborted reception of data is unimplemented" << endl;
         }
@@ -420,6 +599,21 @@ void ORWMac::completePacketReception()
     }
 }
 
+bool ORWMac::isNextBurstFrame(const cMessage* const msg) const
+{
+    if(!fragmentBurst || currentRxFrame == nullptr)
+        return false;
+    auto incomingFrame = check_and_cast<const Packet*>(msg);
+    if(incomingFrame->peekAtFront<ORWGram>()->getType() != ORW_DATA)
+        return false;
+    auto incomingData = incomingFrame->peekAtFront<ORWDatagram>();
+    auto storedData = check_and_cast<const Packet*>(currentRxFrame)->peekAtFront<ORWDatagram>();
+    // A retransmission repeats the sequence number, the next burst frame does not
+    return storedData->getFramePending()
+            && storedData->getTransmitterAddress() == incomingData->getTransmitterAddress()
+            && storedData->getSequenceNumber() != incomingData->getSequenceNumber();
+}
+
 void ORWMac::handleStartOperation(LifecycleOperation *operation) {
     // complete unfinished reception
     completePacketReception();
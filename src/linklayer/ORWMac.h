@@ -64,6 +64,7 @@ protected:
         DATA_WAIT, // Wait for receivers to wake-up
         DATA, // Send data when radio ready
         ACK_WAIT, // Listen for node acknowledging
+        BEACON_WAIT, // Listen for a forwarder beacon before the data (receiver initiated)
         END // Reset
     };
 
@@ -129,8 +130,17 @@ protected:
     omnetpp::simtime_t dataListeningDuration{0};
     omnetpp::simtime_t ackWaitDuration{0};
     double candiateRelayContentionProbability = 0.7;
+    bool energyAwareForwarding{false};
+    double energyAwareContentionBias{0.5};
     bool checkDataPacketEqDC{true};
     bool skipDirectTxFinalAck{false};
+    bool fragmentBurst{false};
+    bool congestionBackpressure{false};
+    double congestionThreshold{0.75};
+    omnetpp::simtime_t congestionHoldDuration{0};
+    omnetpp::simtime_t congestionBackoff{0};
+    EqDC forwarderWideningStep{0};
+    omnetpp::simtime_t retryBackoff{0};
 
     /** @brief Calculated (in initialize) parameters */
     /*@{*/
@@ -143,6 +153,32 @@ protected:
 
     inet::power::IEpEnergyStorage* energyStorage{nullptr};
 
+    /** @name Energy aware forwarding */
+    /*@{*/
+    // Highest headroom advertised in ACKs overheard for the current reception
+    double maxOverheardHeadroom{0};
+    double calculateEnergyHeadroom() const;
+    virtual inet::INetfilter::IHook::Result datagramPreRoutingHook(inet::Packet* datagram) override;
+    static omnetpp::simsignal_t forwardingEnergyHeadroomSignal;
+    /*@}*/
+
+    /** @name Congestion backpressure */
+    /*@{*/
+    // Lowest costs of congested and uncongested forwarders acknowledging the current transmission
+    ExpectedCost congestedForwarderCost{255};
+    ExpectedCost uncongestedForwarderCost{255};
+    // Forwarders at or above congestionExcludedCost are not asked until congestionExcludedUntil
+    ExpectedCost congestionExcludedCost{255};
+    omnetpp::simtime_t congestionExcludedUntil{0};
+    omnetpp::simtime_t congestionHoldUntil{0};
+    uint8_t calculateQueueState() const;
+    void updateCongestionExclusion();
+    void endTransmissionCongestionCheck();
+    omnetpp::simtime_t transmissionStartTime() const {return std::max(omnetpp::simTime(), congestionHoldUntil);};
+    static omnetpp::simsignal_t congestedForwarderAckSignal;
+    static omnetpp::simsignal_t congestionBackoffSignal;
+    /*@}*/
+
     virtual void initialize(int stage) override;
     virtual void configureNetworkInterface() override;
     virtual void cancelAllTimers();
@@ -178,6 +214,8 @@ protected:
     /*@{*/
     int rxAckRound = 0;
     EqDC acceptDataEqDCThreshold = EqDC(25.5);
+    EqDC ownCostInd = EqDC(25.5); // Own EqDC last indicated by the routing layer on a frame
+    void updateOwnCostInd(const inet::Packet* packet);
     cMessage *currentRxFrame{nullptr};
     bool deferredDuplicateDrop{false};
     void decapsulate(inet::Packet* msg) const;
@@ -185,10 +223,14 @@ protected:
     void dropCurrentRxFrame(inet::PacketDropDetails& details);
     void emitEncounterFromWeightedPacket(omnetpp::simsignal_t signal, double weight, const inet::Packet* data);
     void handleCoincidentalOverheardData(const inet::Packet* receivedData){
-        emitEncounterFromWeightedPacket(coincidentalEncounterSignal, 2.0, receivedData);
+        // Short wake-ups do not identify their transmitter
+        if(!receivedData->peekAtFront<ORWGram>()->getTransmitterAddress().isUnspecified())
+            emitEncounterFromWeightedPacket(coincidentalEncounterSignal, 2.0, receivedData);
     }
     void handleOverheardAckInDataReceiveState(const inet::Packet * const msg);
+    double relayContentionProbability() const;
     void completePacketReception();
+    bool isNextBurstFrame(const cMessage* msg) const;
     /*@}*/
 
     /** @name Receiving State variables and event processing */
@@ -221,11 +263,15 @@ protected:
     int txInProgressTries{0};
     int acknowledgedForwarders{0};
     int acknowledgmentRound{1};
+    uint8_t txSequenceNumber{0};
     void setupTransmission();
     bool transmissionStartEnergyCheck() const;
+    // retryCount relaxes the required forwarder cost by forwarderWideningStep per earlier try
     void setBeaconFieldsFromTags(const inet::Packet* subject,
-            const inet::Ptr<ORWBeacon>& wuHeader) const;
+            const inet::Ptr<ORWBeacon>& wuHeader, const int retryCount = 0) const;
     void encapsulate(inet::Packet* msg) const;
+    // The queue head is the next fragment of the frame's datagram, so the burst may continue
+    bool isNextFragmentQueued(const inet::Packet* frame) const;
     void dropCurrentTxFrame(inet::PacketDropDetails& details) override{
         MacProtocolBase::dropCurrentTxFrame(details);
         emit(transmissionTriesSignal, txInProgressTries);
@@ -237,6 +283,14 @@ protected:
         emit(transmissionEndedSignal, true);
     }
     void completePacketTransmission();
+    // Delay before the next try of the current frame, lets browned out forwarders recharge
+    omnetpp::simtime_t retryDelay() const;
+    static omnetpp::simsignal_t successfulTransmissionTriesSignal;
+    /*
+     * Overridable by inherited class to use extra fields of acknowledgements
+     * addressed to this node
+     */
+    virtual void handleForwarderAck(const inet::Packet* ack);
     /*@}*/
 
     virtual State stateAwaitTransmitProcess(const MacEvent& event, omnetpp::cMessage* const msg);
@@ -247,6 +301,8 @@ protected:
     TxDataState txDataState;
     virtual State stateTxEnter();
     void stateTxEnterDataWait();
+    // Upper limit of the CSMA backoff before each data transmission
+    virtual omnetpp::simtime_t dataContentionWindow() const {return initialContentionDuration;};
     void stateTxDataWaitExitEnterData();
     void stateTxEnterEnd();
     /*
@@ -8,6 +8,9 @@
 #include <inet/linklayer/common/MacAddressTag_m.h>
 #include "common/EqDCTag_m.h"
 #include "common/EncounterDetails_m.h"
+#ifdef OPPOSTACK_DELAY_TRACKING
+#include "statistics/PacketDelayTag_m.h"
+#endif
 
 using namespace inet;
 using physicallayer::IRadio;
@@ -27,7 +30,8 @@ void ORWMac::stateProcess(const MacEvent& event, cMessage * const msg) {
         else if (event == MacEvent::QUEUE_SEND) {
             ASSERT(currentTxFrame == nullptr);
             setupTransmission();
-            if (dataRadio->getRadioMode() == IRadio::RADIO_MODE_SWITCHING || !transmissionStartEnergyCheck()) {
+            if (dataRadio->getRadioMode() == IRadio::RADIO_MODE_SWITCHING || !transmissionStartEnergyCheck()
+                    || transmissionStartTime() > simTime()) {
                 ret = stateListeningEnterAlreadyListening();
             }
             else {
@@ -67,7 +71,7 @@ ORWMac::State ORWMac::stateListeningEnterAlreadyListening(){
         if(!transmissionStartEnergyCheck())
             scheduleAt(simTime() + replenishmentCheckRate, replenishmentTimer);
         else if (dataRadio->getRadioMode() != IRadio::RADIO_MODE_SWITCHING )
-            scheduleAt(simTime(), transmitStartDelay);
+            scheduleAt(transmissionStartTime(), transmitStartDelay);
         return State::AWAIT_TRANSMIT;
     }
     else{
@@ -100,6 +104,12 @@ bool ORWMac::stateReceiveProcess(const MacEvent& event, cMessage * const msg) {
                 return true;
             }
             else if(event == MacEvent::DATA_RECEIVED){
+                if(isNextBurstFrame(msg)){
+                    // Acknowledged frame is complete, receive the next one of the burst
+                    completePacketReception();
+                    emit(receptionStartedSignal, true);
+                    rxAckRound = 0;
+                }
                 stateReceiveDataWaitProcessDataReceived(msg);
             }
             // Transition from ACK after TX_END
@@ -190,7 +200,12 @@ void ORWMac::stateReceiveEnterAck()
     rxAckRound++;
     activeBackoff = new CSMATxRemainderReciprocalBackoff(this, dataRadio,
             ackTxWaitDuration, minimumContentionWindow);
-    activeBackoff->delayCarrierSense(uniform(0, initialContentionDuration));
+    // Nodes with less energy headroom start contending later, so others win the ACK race
+    simtime_t contentionStart = 0;
+    if(energyAwareForwarding){
+        contentionStart = initialContentionDuration*energyAwareContentionBias*(1 - calculateEnergyHeadroom());
+    }
+    activeBackoff->delayCarrierSense(uniform(contentionStart, initialContentionDuration));
     rxState = RxState::ACK;
 }
 
@@ -234,8 +249,12 @@ void ORWMac::stateReceiveDataWaitProcessDataReceived(cMessage * const msg) {
     Packet* storedFrame = check_and_cast_nullable<Packet*>(currentRxFrame);
     if(incomingMacData->getType()==ORW_DATA && currentRxFrame == nullptr){
         stateReceiveExitDataWait();
+        maxOverheardHeadroom = 0;
         // Store the new received packet
         currentRxFrame = incomingFrame;
+#ifdef OPPOSTACK_DELAY_TRACKING
+        incomingFrame->addTagIfAbsent<MacTimingInd>()->setDataReceived(simTime());
+#endif
 
         // Check using packet data that accepting wake-up is still correct
         INetfilter::IHook::Result preRoutingResponse = datagramPreRoutingHook(incomingFrame);
@@ -266,6 +285,9 @@ void ORWMac::stateReceiveDataWaitProcessDataReceived(cMessage * const msg) {
         stateReceiveExitDataWait();
         // Store the new received packet
         currentRxFrame = incomingFrame;
+#ifdef OPPOSTACK_DELAY_TRACKING
+        incomingFrame->addTagIfAbsent<MacTimingInd>()->setDataReceived(simTime());
+#endif
 
 
         // TODO: Make Opportunistic Contention Decision
@@ -288,7 +310,7 @@ void ORWMac::stateReceiveDataWaitProcessDataReceived(cMessage * const msg) {
                 stateReceiveEnterFinish();
             }
             else if(destinationAckPersistance ||
-                    relayDiceRoll<candiateRelayContentionProbability){
+                    relayDiceRoll<relayContentionProbability()){
                 // Continue to contend for packet
                 stateReceiveEnterAck();
             }
@@ -451,7 +473,7 @@ void ORWMac::stateTxEnterDataWait()
     // use activeBackoff for backoff state machine
     ASSERT(activeBackoff == nullptr);
     activeBackoff = new CSMATxUniformBackoff(this, dataRadio,
-            0.0, ackWaitDuration/3);
+            0.0, dataContentionWindow());
     if(dataRadio->getRadioMode() == IRadio::RADIO_MODE_RECEIVER){
         activeBackoff->startTxOrBackoff();
     }
@@ -464,6 +486,14 @@ void ORWMac::stateTxDataWaitExitEnterData()
 {
     delete activeBackoff;
     activeBackoff = nullptr;
+#ifdef OPPOSTACK_DELAY_TRACKING
+    auto timing = currentTxFrame->addTagIfAbsent<MacTimingInd>();
+    if(timing->getFirstTryStarted() < 0){
+        // No wake-up radio, the first try starts with its data
+        timing->setFirstTryStarted(simTime());
+    }
+    timing->setTxTries(txInProgressTries);
+#endif
     Packet* dataFrame = currentTxFrame->dup();
     if(datagramPostRoutingHook(dataFrame)!=INetfilter::IHook::Result::ACCEPT){
         EV_ERROR << "Aborted transmission of data is unimplemented." << endl;
@@ -496,6 +526,7 @@ void ORWMac::stateTxAckWaitProcess(const MacEvent& event, cMessage * const msg)
                 // Update value of EqDC on Tag
                 dataMinExpectedCost = EqDC(0.0);
             }
+            handleForwarderAck(receivedData);
             delete receivedData;
         }
         else{
@@ -512,6 +543,7 @@ void ORWMac::stateTxAckWaitProcess(const MacEvent& event, cMessage * const msg)
         emit(ACKreceivedSignal, (double)acknowledgedForwarders);
 
         auto broadcastTag = currentTxFrame->findTag<EqDCBroadcast>();
+        updateCongestionExclusion();
 
         // TODO: Get required forwarders count from packetTag from n/w layer
         // TODO: Test this with more nodes should this include forwarders from prev timeslot?
@@ -531,12 +563,23 @@ void ORWMac::stateTxAckWaitProcess(const MacEvent& event, cMessage * const msg)
         }
         else{
             txInProgressForwarders = txInProgressForwarders+acknowledgedForwarders; // TODO: Check forwarders uniqueness
+            // The forwarder keeps listening after its ack, so the next fragment needs no wake-up
+            const bool continueBurst = fragmentBurst && acknowledgedForwarders > 0
+                    && isNextFragmentQueued(currentTxFrame);
+            endTransmissionCongestionCheck();
             completePacketTransmission();
             if(currentTxFrame){//Not complete yet
                 // Try transmitting again after standard ack backoff
-                scheduleAt(simTime() + ackWaitDuration, transmitStartDelay);
+                scheduleAt(simTime() + retryDelay(), transmitStartDelay);
+                stateTxEnterEnd();
+            }
+            else if(continueBurst){
+                setupTransmission();
+                ORWMac::stateTxEnter();
+            }
+            else{
+                stateTxEnterEnd();
             }
-            stateTxEnterEnd();
         }
     }
 }
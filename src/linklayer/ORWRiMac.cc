@@ -0,0 +1,192 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "ORWRiMac.h"
+#include <inet/common/ProtocolTag_m.h>
+#include <inet/linklayer/common/MacAddressTag_m.h>
+#include <inet/physicallayer/wireless/common/contract/packetlevel/IRadio.h>
+
+#include "common/EqDCTag_m.h"
+
+using namespace inet;
+using physicallayer::IRadio;
+using namespace oppostack;
+
+Define_Module(ORWRiMac);
+
+simsignal_t ORWRiMac::beaconSentSignal = cComponent::registerSignal("beaconSent");
+simsignal_t ORWRiMac::beaconWaitSignal = cComponent::registerSignal("beaconWait");
+
+void ORWRiMac::initialize(int stage)
+{
+    ORWLplMac::initialize(stage);
+    if(stage == INITSTAGE_LOCAL){
+        beaconWaitDuration = par("beaconWaitDuration");
+        if(beaconWaitDuration < checkInterval)
+            EV_WARN << "beaconWaitDuration is shorter than checkInterval, senders may miss every beacon" << endl;
+    }
+}
+
+void ORWRiMac::handleSelfMessage(cMessage* const msg)
+{
+    if(msg == channelCheckTimer){
+        scheduleAt(simTime() + checkInterval, channelCheckTimer);
+        if(macState == State::DATA_IDLE && beaconState == BeaconState::OFF
+                && dataRadio->getRadioMode() == IRadio::RADIO_MODE_SLEEP && transmissionStartEnergyCheck()){
+            // Wake the data radio to sense the channel before the beacon
+            beaconState = BeaconState::RADIO_WAIT;
+            dataRadio->setRadioMode(IRadio::RADIO_MODE_RECEIVER);
+        }
+    }
+    else{
+        ORWLplMac::handleSelfMessage(msg);
+    }
+}
+
+void ORWRiMac::cancelAllTimers()
+{
+    ORWLplMac::cancelAllTimers();
+    beaconState = BeaconState::OFF;
+}
+
+void ORWRiMac::stateProcess(const MacEvent& event, cMessage* const msg)
+{
+    if(macState != State::DATA_IDLE || beaconState == BeaconState::OFF){
+        ORWLplMac::stateProcess(event, msg);
+        return;
+    }
+    if(event == MacEvent::QUEUE_SEND){
+        // Queued packets are sent once the beacon period is over
+        return;
+    }
+    switch(beaconState){
+    case BeaconState::RADIO_WAIT:
+        if(event == MacEvent::DATA_RX_READY){
+            if(receptionState == IRadio::RECEPTION_STATE_IDLE){
+                beaconState = BeaconState::TX;
+                dataRadio->setRadioMode(IRadio::RADIO_MODE_TRANSMITTER);
+            }
+            else{
+                // Channel busy, listen instead of adding to the contention
+                stateBeaconEnterListen();
+            }
+        }
+        break;
+    case BeaconState::TX:
+        if(event == MacEvent::TX_READY){
+            sendDown(buildBeacon());
+            emit(beaconSentSignal, true);
+        }
+        else if(event == MacEvent::TX_END){
+            dataRadio->setRadioMode(IRadio::RADIO_MODE_RECEIVER);
+            stateBeaconEnterListen();
+        }
+        break;
+    case BeaconState::LISTEN:
+        if(event == MacEvent::DATA_TIMEOUT){
+            if(receptionState != IRadio::RECEPTION_STATE_IDLE && !beaconListenExtended){
+                // Data reception may be in progress, wait for it to complete
+                beaconListenExtended = true;
+                scheduleAt(simTime() + dataListeningDuration, receiveTimeout);
+            }
+            else{
+                beaconState = BeaconState::OFF;
+                macState = stateListeningEnter();
+            }
+        }
+        else if(event == MacEvent::DATA_RECEIVED){
+            auto packet = check_and_cast<Packet*>(msg);
+            if(packet->peekAtFront<ORWGram>()->getType() == ORWGramType::ORW_BEACON){
+                // Another forwarder's beacon, keep listening for data
+                delete packet;
+            }
+            else{
+                // Hand over to the ORWMac reception
+                cancelEvent(receiveTimeout);
+                beaconState = BeaconState::OFF;
+                ORWLplMac::stateProcess(event, msg);
+            }
+        }
+        break;
+    default:
+        throw cRuntimeError("Unknown beacon state");
+    }
+}
+
+void ORWRiMac::stateBeaconEnterListen()
+{
+    beaconState = BeaconState::LISTEN;
+    beaconListenExtended = false;
+    scheduleAt(simTime() + checkDuration, receiveTimeout);
+}
+
+Packet* ORWRiMac::buildBeacon()
+{
+    auto beaconHeader = makeShared<ORWBeacon>();
+    beaconHeader->setTransmitterAddress(networkInterface->getMacAddress());
+    beaconHeader->setReceiverAddress(MacAddress::BROADCAST_ADDRESS);
+    beaconHeader->setMinExpectedCost(EqDC(25.5));
+    // Advertise the cost the routing layer last indicated on sent or received frames
+    beaconHeader->setExpectedCostInd(ownCostInd);
+    auto beacon = new Packet("beacon", beaconHeader);
+    beacon->addTag<PacketProtocolTag>()->setProtocol(&ORWProtocol);
+    return beacon;
+}
+
+ORWMac::State ORWRiMac::stateTxEnter()
+{
+    dataMinExpectedCost = EqDC(25.5);
+    acknowledgmentRound = 0;
+    txInProgressTries++;
+    txDataState = TxDataState::BEACON_WAIT;
+    beaconWaitStart = simTime();
+    dataRadio->setRadioMode(IRadio::RADIO_MODE_RECEIVER);
+    scheduleAt(simTime() + beaconWaitDuration, receiveTimeout);
+    return State::TRANSMIT;
+}
+
+bool ORWRiMac::stateTxProcess(const MacEvent& event, cMessage* const msg)
+{
+    if(txDataState != TxDataState::BEACON_WAIT){
+        // Data and ACK contention as ORWMac, without strobing
+        return ORWMac::stateTxProcess(event, msg);
+    }
+    if(event == MacEvent::DATA_RECEIVED){
+        auto packet = check_and_cast<Packet*>(msg);
+        handleCoincidentalOverheardData(packet);
+        if(isAcceptableBeacon(packet)){
+            cancelEvent(receiveTimeout);
+            emit(beaconWaitSignal, simTime() - beaconWaitStart);
+            stateTxEnterDataWait();
+        }
+        delete packet;
+    }
+    else if(event == MacEvent::DATA_TIMEOUT){
+        // No suitable forwarder beaconed, count as a failed try
+        completePacketTransmission();
+        if(currentTxFrame){
+            scheduleAt(simTime() + retryDelay(), transmitStartDelay);
+        }
+        stateTxEnterEnd();
+    }
+    return false;
+}
+
+bool ORWRiMac::isAcceptableBeacon(const Packet* const packet) const
+{
+    const auto beaconHeader = packet->peekAtFront<ORWGram>();
+    if(beaconHeader->getType() != ORWGramType::ORW_BEACON){
+        return false;
+    }
+    // Same requirement the frame would carry in a wake-up
+    auto required = makeShared<ORWBeacon>();
+    setBeaconFieldsFromTags(currentTxFrame, required, txInProgressTries - 1);
+    if(beaconHeader->getTransmitterAddress() == required->getReceiverAddress()){
+        return true;
+    }
+    const auto upwardsTag = currentTxFrame->findTag<EqDCUpwards>();
+    const bool upwards = upwardsTag == nullptr || upwardsTag->isUpwards();
+    return upwards && beaconHeader->getExpectedCostInd() <= required->getMinExpectedCost();
+}
@@ -0,0 +1,61 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef LINKLAYER_ORWRIMAC_H_
+#define LINKLAYER_ORWRIMAC_H_
+
+#include <omnetpp.h>
+
+#include "ORWLplMac.h"
+
+namespace oppostack {
+
+/**
+ * ORWRiMac - Receiver initiated variant of ORWMac. Idle forwarders wake
+ * every checkInterval and broadcast a beacon with their EqDC, then listen
+ * for data. Senders listen for the first beacon that satisfies the
+ * minExpectedCost of the frame and then follow the ORWMac data and
+ * ACK contention.
+ */
+class ORWRiMac : public ORWLplMac
+{
+  protected:
+    /** @brief User Configured parameters */
+    omnetpp::simtime_t beaconWaitDuration{0};
+
+    /** @name Beaconing (receiver) */
+    /*@{*/
+    enum class BeaconState {
+        OFF, // Sleeping or handled by ORWMac
+        RADIO_WAIT, // Data radio switching to listening for carrier sense
+        TX, // Beacon transmission
+        LISTEN // Listen for data following the beacon
+    };
+    BeaconState beaconState{BeaconState::OFF};
+    bool beaconListenExtended{false};
+    inet::Packet* buildBeacon();
+    void stateBeaconEnterListen();
+    static omnetpp::simsignal_t beaconSentSignal;
+    /*@}*/
+
+    /** @name Beacon wait (transmitter) */
+    /*@{*/
+    omnetpp::simtime_t beaconWaitStart{0};
+    bool isAcceptableBeacon(const inet::Packet* packet) const;
+    static omnetpp::simsignal_t beaconWaitSignal;
+    /*@}*/
+
+    virtual void initialize(int stage) override;
+    virtual void handleSelfMessage(omnetpp::cMessage* msg) override;
+    virtual void cancelAllTimers() override;
+
+    virtual void stateProcess(const MacEvent& event, omnetpp::cMessage* msg) override;
+    virtual State stateTxEnter() override;
+    virtual bool stateTxProcess(const MacEvent& event, omnetpp::cMessage* msg) override;
+};
+
+} /* namespace oppostack */
+
+#endif /* LINKLAYER_ORWRIMAC_H_ */
@@ -0,0 +1,135 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include <inet/physicallayer/wireless/common/contract/packetlevel/IRadio.h>
+
+#include "common/oppDefs.h"
+#include "WakeUpCorrelator.h"
+#include "WakeUpMacLayer.h"
+
+using namespace oppostack;
+using namespace inet;
+using physicallayer::IRadio;
+
+Define_Module(WakeUpCorrelator);
+
+simsignal_t WakeUpCorrelator::correlatorMatchSignal = cComponent::registerSignal("correlatorMatch");
+simsignal_t WakeUpCorrelator::falseWakeUpSignal = cComponent::registerSignal("falseWakeUp");
+
+void WakeUpCorrelator::initialize(int stage)
+{
+    if(stage == INITSTAGE_LOCAL){
+        correlatorBits = par("correlatorBits");
+        matchLatency = par("matchLatency");
+        matchEnergy = J(par("matchEnergy"));
+        falseWakeUpProbability = par("falseWakeUpProbability");
+        mcuInterruptEnergy = J(par("mcuInterruptEnergy"));
+        mcuInterruptDuration = par("mcuInterruptDuration");
+        if(correlatorBits < 1 || correlatorBits > 8)
+            throw cRuntimeError("correlatorBits must be between 1 and 8");
+        if(falseWakeUpProbability < 0 || falseWakeUpProbability > 1)
+            throw cRuntimeError("falseWakeUpProbability must be between 0 and 1");
+        if((matchEnergy > J(0) && matchLatency <= 0) || (mcuInterruptEnergy > J(0) && mcuInterruptDuration <= 0))
+            throw cRuntimeError("Energy must be consumed over a positive duration");
+
+        pulseEndTimer = new cMessage("correlator energy pulse end");
+        mac = check_and_cast<WakeUpMacLayer*>(getCModuleFromPar(par("macModule"), this));
+        const char* energySourcePath = par("energySourceModule");
+        if(*energySourcePath != '\0'){
+            energySource = check_and_cast<power::IEpEnergySource*>(getModuleByPath(energySourcePath));
+            energySource->addEnergyConsumer(this);
+        }
+        emit(powerConsumptionChangedSignal, powerConsumption.get());
+
+        cModule* wakeUpRadioModule = getCModuleFromPar(par("wakeUpRadioModule"), this);
+        wakeUpRadioModule->subscribe(IRadio::receptionStateChangedSignal, this);
+    }
+}
+
+void WakeUpCorrelator::program(const MacAddress& address, const EqDC ownCost)
+{
+    Enter_Method_Silent("program");
+    programmedAddress = address;
+    programmedCost = ownCost;
+}
+
+uint64_t WakeUpCorrelator::quantise(const uint64_t value, const int fieldBits) const
+{
+    // Keep the most significant correlatorBits of the field
+    return fieldBits > correlatorBits ? value >> (fieldBits - correlatorBits) : value;
+}
+
+bool WakeUpCorrelator::correlate(const ORWGram* const wakeUpHeader)
+{
+    Enter_Method_Silent("correlate");
+    consumeEnergy(matchEnergy, matchLatency);
+    const MacAddress receiverAddress = wakeUpHeader->getReceiverAddress();
+    const uint64_t addressMask = ((uint64_t)1 << correlatorBits) - 1;
+    bool match = receiverAddress.isBroadcast() || receiverAddress.isMulticast()
+            || (!receiverAddress.isUnspecified() && ((receiverAddress.getInt() ^ programmedAddress.getInt()) & addressMask) == 0);
+    auto beaconHeader = dynamic_cast<const ORWBeacon*>(wakeUpHeader);
+    if(!match && beaconHeader != nullptr && beaconHeader->getUpwards()){
+        // Rounding both costs down only adds false matches, never misses a forwarder
+        match = quantise(programmedCost.get(), 8) <= quantise(beaconHeader->getMinExpectedCost().get(), 8);
+    }
+    emit(correlatorMatchSignal, match);
+    if(match){
+        consumeEnergy(mcuInterruptEnergy, mcuInterruptDuration);
+    }
+    return match;
+}
+
+void WakeUpCorrelator::receiveSignal(cComponent* const source, simsignal_t const signalID,
+        intval_t const value, cObject* const details)
+{
+    Enter_Method_Silent();
+    if(signalID != IRadio::receptionStateChangedSignal
+            || static_cast<IRadio::ReceptionState>(value) != IRadio::RECEPTION_STATE_BUSY){
+        return;
+    }
+    // Detected signal that the wake-up radio cannot decode still reaches the correlator
+    consumeEnergy(matchEnergy, matchLatency);
+    if(uniform(0, 1) < falseWakeUpProbability && mac->handleFalseWakeUp()){
+        emit(falseWakeUpSignal, true);
+        consumeEnergy(mcuInterruptEnergy, mcuInterruptDuration);
+    }
+}
+
+void WakeUpCorrelator::consumeEnergy(const J energy, const simtime_t duration)
+{
+    if(energySource == nullptr || energy <= J(0)){
+        return;
+    }
+    activePulses.emplace(simTime() + duration, energy/s(duration.dbl()));
+    updatePowerConsumption();
+}
+
+void WakeUpCorrelator::handleMessage(cMessage* const msg)
+{
+    ASSERT(msg == pulseEndTimer);
+    activePulses.erase(activePulses.begin(), activePulses.upper_bound(simTime()));
+    updatePowerConsumption();
+}
+
+void WakeUpCorrelator::updatePowerConsumption()
+{
+    W totalPower = W(0);
+    for(const auto& pulse : activePulses){
+        totalPower += pulse.second;
+    }
+    if(totalPower != powerConsumption){
+        powerConsumption = totalPower;
+        emit(powerConsumptionChangedSignal, powerConsumption.get());
+    }
+    cancelEvent(pulseEndTimer);
+    if(!activePulses.empty()){
+        scheduleAt(activePulses.begin()->first, pulseEndTimer);
+    }
+}
+
+WakeUpCorrelator::~WakeUpCorrelator()
+{
+    cancelAndDelete(pulseEndTimer);
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef LINKLAYER_WAKEUPCORRELATOR_H_
+#define LINKLAYER_WAKEUPCORRELATOR_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <inet/common/Units.h>
+#include <inet/linklayer/common/MacAddress.h>
+#include <inet/power/contract/IEpEnergyConsumer.h>
+#include <inet/power/contract/IEpEnergySource.h>
+
+#include "common/Units.h"
+#include "ORWGram_m.h"
+
+namespace oppostack {
+
+class WakeUpMacLayer;
+
+/**
+ * Address and cost correlator of a wake-up receiver, decides which decoded
+ * wake-ups interrupt the MCU and injects false wake-ups from interference
+ */
+class WakeUpCorrelator : public omnetpp::cSimpleModule, public omnetpp::cListener, public inet::power::IEpEnergyConsumer
+{
+public:
+    static omnetpp::simsignal_t correlatorMatchSignal;
+    static omnetpp::simsignal_t falseWakeUpSignal;
+
+    // Program the correlator with the fields the node matches on
+    void program(const inet::MacAddress& address, const EqDC ownCost);
+    // Correlate a decoded wake-up, true if it interrupts the MCU
+    bool correlate(const ORWGram* wakeUpHeader);
+    omnetpp::simtime_t getMatchLatency() const {return matchLatency;};
+
+    virtual inet::power::IEnergySource *getEnergySource() const override {return energySource;};
+    virtual inet::W getPowerConsumption() const override {return powerConsumption;};
+    ~WakeUpCorrelator();
+
+protected:
+    int correlatorBits{8};
+    omnetpp::simtime_t matchLatency{0};
+    inet::J matchEnergy{0};
+    double falseWakeUpProbability{0};
+    inet::J mcuInterruptEnergy{0};
+    omnetpp::simtime_t mcuInterruptDuration{0};
+
+    inet::MacAddress programmedAddress;
+    ExpectedCost programmedCost{0}; // Matches every upwards wake-up until programmed
+
+    WakeUpMacLayer* mac{nullptr};
+    inet::power::IEpEnergySource* energySource{nullptr};
+    inet::W powerConsumption{0};
+    std::multimap<omnetpp::simtime_t, inet::W> activePulses; // End time and power of each energy pulse
+    omnetpp::cMessage* pulseEndTimer{nullptr};
+
+    virtual int numInitStages() const override {return inet::NUM_INIT_STAGES;};
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(omnetpp::cMessage* msg) override;
+    using omnetpp::cListener::receiveSignal;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, omnetpp::intval_t value, omnetpp::cObject* details) override;
+
+    uint64_t quantise(uint64_t value, int fieldBits) const;
+    void consumeEnergy(const inet::J energy, const omnetpp::simtime_t duration);
+    void updatePowerConsumption();
+};
+
+} /* namespace oppostack */
+
+#endif /* LINKLAYER_WAKEUPCORRELATOR_H_ */
@@ -6,19 +6,25 @@
 #include "WakeUpMacLayer.h"
 #include <omnetpp.h>
 #include <algorithm> // for min max
+#include <inet/common/INETMath.h>
 #include <inet/common/ModuleAccess.h>
 #include <inet/common/ProtocolGroup.h>
 #include <inet/common/ProtocolTag_m.h>
 #include <inet/linklayer/common/InterfaceTag_m.h>
 #include <inet/linklayer/common/MacAddressTag_m.h>
 #include <inet/common/packet/chunk/Chunk.h>
+#include <inet/physicallayer/wireless/common/base/packetlevel/FlatRadioBase.h>
 #include <inet/physicallayer/wireless/common/base/packetlevel/FlatReceiverBase.h>
 #include <inet/physicallayer/wireless/common/base/packetlevel/FlatTransmitterBase.h>
+#include <inet/physicallayer/wireless/common/contract/packetlevel/SignalTag_m.h>
 
 #include "common/EqDCTag_m.h"
 #include "common/EncounterDetails_m.h"
 #include "MacEnergyMonitor.h"
 #include "ORWGram_m.h"
+#ifdef OPPOSTACK_DELAY_TRACKING
+#include "statistics/PacketDelayTag_m.h"
+#endif
 
 using namespace inet;
 using physicallayer::IRadio;
@@ -27,6 +33,14 @@ using physicallayer::FlatTransmitterBase;
 
 Define_Module(WakeUpMacLayer);
 
+simsignal_t WakeUpMacLayer::txWakeUpWaitSignal = cComponent::registerSignal("txWakeUpWait");
+simsignal_t WakeUpMacLayer::dataChannelSignal = cComponent::registerSignal("dataChannel");
+simsignal_t WakeUpMacLayer::ackCollisionSignal = cComponent::registerSignal("ackCollision");
+simsignal_t WakeUpMacLayer::dataTxPowerSignal = cComponent::registerSignal("dataTxPower");
+simsignal_t WakeUpMacLayer::wakeUpTxPowerSignal = cComponent::registerSignal("wakeUpTxPower");
+simsignal_t WakeUpMacLayer::txEnergyEstimateSignal = cComponent::registerSignal("txEnergyEstimate");
+simsignal_t WakeUpMacLayer::wakeUpEnergySavedSignal = cComponent::registerSignal("wakeUpEnergySaved");
+
 void WakeUpMacLayer::initialize(int const stage) {
     ORWMac::initialize(stage);
 //    // Allow serialization to better represent conflicting radio protocols
@@ -39,12 +53,29 @@ void WakeUpMacLayer::initialize(int const stage) {
         //Create timer messages
         txWakeUpWaitDuration = par("txWakeUpWaitDuration");
         wuApproveResponseLimit = par("wuApproveResponseLimit");
+        txWakeUpWait = txWakeUpWaitDuration;
+
+        phaseLocking = par("phaseLocking");
+        phaseLockStep = par("phaseLockStep");
+        phaseLockMinWait = par("phaseLockMinWait");
+        phaseLockMinAvailability = par("phaseLockMinAvailability");
+        phaseLockAvailabilityWeight = par("phaseLockAvailabilityWeight");
+        if(phaseLocking && (phaseLockMinWait <= 0 || phaseLockMinWait > txWakeUpWaitDuration))
+            throw cRuntimeError("phaseLockMinWait must be positive and at most txWakeUpWaitDuration");
 
         maxTxTries = par("maxTxTries");
 
         const char* wakeUpRadioModulePath = par("wakeUpRadioModule");
         cModule *radioModule = getModuleByPath(wakeUpRadioModulePath);
         wakeUpRadio = check_and_cast<IRadio *>(radioModule);
+        cModule* const wakeUpEnergyConsumer = radioModule->getSubmodule("energyConsumer");
+        if(wakeUpEnergyConsumer != nullptr && wakeUpEnergyConsumer->hasPar("transmitterTransmittingPowerConsumption")){
+            wakeUpTransmitPower = W(wakeUpEnergyConsumer->par("transmitterTransmittingPowerConsumption"));
+        }
+        const char* correlatorModulePath = par("correlatorModule");
+        if(*correlatorModulePath != '\0'){
+            correlator = check_and_cast<WakeUpCorrelator*>(getModuleByPath(correlatorModulePath));
+        }
 
         // Retransmission reduction through data packet updating
         checkDataPacketEqDC = par("checkDataPacketEqDC");
@@ -61,6 +92,47 @@ void WakeUpMacLayer::initialize(int const stage) {
         if(not dynamicWakeUpChecking && wakeUpMessageDuration <= 0)
             throw cRuntimeError("Wake Up message duration must be set if dynamic wake-up is not enabled");
 
+        dataChannels = par("dataChannels");
+        channelFailureWeight = par("channelFailureWeight");
+        channelFailure.assign(dataChannels, 0);
+        if(dataChannels < 1 || dataChannels > 255)
+            throw cRuntimeError("dataChannels must be between 1 and 255");
+        auto dataTransmitterModel = check_and_cast<const FlatTransmitterBase*>(dataRadio->getTransmitter());
+        baseCenterFrequency = dataTransmitterModel->getCenterFrequency();
+        channelSpacing = Hz(par("channelSpacing"));
+        if(channelSpacing == Hz(0))
+            channelSpacing = dataTransmitterModel->getBandwidth();
+        if(dataChannels > 1 && channelSpacing < dataTransmitterModel->getBandwidth())
+            throw cRuntimeError("Data channels must not overlap, channelSpacing is less than the data radio bandwidth");
+
+        transmitPowerControl = par("transmitPowerControl");
+        powerControlForwarders = par("powerControlForwarders");
+        powerControlMargin = par("powerControlMargin");
+        powerControlRetryStep = par("powerControlRetryStep");
+        pathLossWeight = par("pathLossWeight");
+        powerAmplifierEfficiency = par("powerAmplifierEfficiency");
+        if(powerAmplifierEfficiency <= 0 || powerAmplifierEfficiency > 1)
+            throw cRuntimeError("powerAmplifierEfficiency must be in (0, 1]");
+        auto wakeUpTransmitterModel = check_and_cast<const FlatTransmitterBase*>(wakeUpRadio->getTransmitter());
+        dataMaxPower = dataTransmitterModel->getPower();
+        wakeUpMaxPower = wakeUpTransmitterModel->getPower();
+        cModule* const dataEnergyConsumer = check_and_cast<cModule*>(dataRadio)->getSubmodule("energyConsumer");
+        if(dataEnergyConsumer != nullptr && dataEnergyConsumer->hasPar("transmitterTransmittingPowerConsumption")){
+            dataTransmitPower = W(dataEnergyConsumer->par("transmitterTransmittingPowerConsumption"));
+        }
+        if(transmitPowerControl){
+            if(powerControlForwarders < 1)
+                throw cRuntimeError("powerControlForwarders must be at least 1");
+            auto dataReceiverModel = check_and_cast<const physicallayer::FlatReceiverBase*>(dataRadio->getReceiver());
+            auto wakeUpReceiverModel = check_and_cast<const physicallayer::FlatReceiverBase*>(wakeUpRadio->getReceiver());
+            dataSensitivity = dataReceiverModel->getSensitivity();
+            wakeUpSensitivity = wakeUpReceiverModel->getSensitivity();
+        }
+
+        shortWakeUp = par("shortWakeUp");
+        if(shortWakeUp && not checkDataPacketEqDC)
+            throw cRuntimeError("Data packet checking must be enabled to resolve short wake-up receivers");
+
 
         auto dataReceiverModel = check_and_cast_nullable<const physicallayer::FlatReceiverBase*>(dataRadio->getReceiver());
         auto wakeUpReceiverModel = check_and_cast_nullable<const physicallayer::FlatReceiverBase*>(wakeUpRadio->getReceiver());
@@ -81,6 +153,7 @@ void WakeUpMacLayer::handleLowerPacket(Packet* const packet) {
     // Process packet from the wake-up radio or delegate handler
     if (packet->getArrivalGateId() == wakeUpRadioInGateId){
         EV_DEBUG << "Received  wake-up packet" << endl;
+        expandShortWakeUp(packet);
         stateProcess(MacEvent::WU_START, packet);
         delete packet;
     }
@@ -99,6 +172,11 @@ void WakeUpMacLayer::receiveSignal(cComponent* const source, simsignal_t const s
     // Check it is for the active radio
     cComponent* activeRadioComponent = check_and_cast_nullable<cComponent*>(activeRadio);
     if(operationalState == OPERATING && activeRadioComponent && activeRadioComponent == source){
+        if(signalID == IRadio::receptionStateChangedSignal && macState == State::TRANSMIT
+                && txDataState == TxDataState::ACK_WAIT && value == IRadio::RECEPTION_STATE_BUSY){
+            // Signal detected but not decodable while waiting for acks
+            ackWaitInterference = true;
+        }
         handleRadioSignal(signalID, value);
     }
 }
@@ -154,7 +232,7 @@ ORWMac::State WakeUpMacLayer::stateListeningEnterAlreadyListening(){
         if(!transmissionStartEnergyCheck())
             scheduleAt(simTime() + replenishmentCheckRate, replenishmentTimer);
         else if (activeRadio->getRadioMode() != IRadio::RADIO_MODE_SWITCHING )
-            scheduleAt(simTime(), transmitStartDelay);
+            scheduleAt(transmissionStartTime(), transmitStartDelay);
         return State::AWAIT_TRANSMIT;
     }
     else{
@@ -173,6 +251,9 @@ WakeUpMacLayer::State WakeUpMacLayer::stateWakeUpIdleProcess(const MacEvent& eve
 {
     const IRadio::RadioMode wuRadioMode = wakeUpRadio->getRadioMode();
     if (event == MacEvent::WU_START) {
+        if(!correlatorMatches(check_and_cast<Packet*>(msg))){
+            return macState;
+        }
         // Start the wake-up state machine
         handleCoincidentalOverheardData(check_and_cast<Packet*>(msg));
         return stateWakeUpWaitApproveWaitEnter(msg);
@@ -180,7 +261,8 @@ WakeUpMacLayer::State WakeUpMacLayer::stateWakeUpIdleProcess(const MacEvent& eve
     else if (event == MacEvent::QUEUE_SEND) {
         ASSERT(currentTxFrame == nullptr);
         setupTransmission();
-        if (wuRadioMode == IRadio::RADIO_MODE_SWITCHING || !transmissionStartEnergyCheck()) {
+        if (wuRadioMode == IRadio::RADIO_MODE_SWITCHING || !transmissionStartEnergyCheck()
+                || transmissionStartTime() > simTime()) {
             return stateListeningEnterAlreadyListening();
         }
         else {
@@ -196,6 +278,9 @@ WakeUpMacLayer::State WakeUpMacLayer::stateWakeUpIdleProcess(const MacEvent& eve
 WakeUpMacLayer::State WakeUpMacLayer::stateAwaitTransmitProcess(const MacEvent& event, cMessage* const msg)
 {
     if (event == MacEvent::WU_START) {
+        if(!correlatorMatches(check_and_cast<Packet*>(msg))){
+            return macState;
+        }
         cancelEvent(transmitStartDelay);
         cancelEvent(replenishmentTimer);
         // Start the wake-up state machine
@@ -251,9 +336,26 @@ bool WakeUpMacLayer::stateTxProcess(const MacEvent& event, cMessage* const msg)
         stepBackoffSM(event);
         if(event==MacEvent::TX_READY){
             // TODO: Change this to a short WU packet
-            cMessage* const currentTxWakeUp = check_and_cast<cMessage*>(buildWakeUp(currentTxFrame, txInProgressTries));
+            txDataChannel = chooseDataChannel();
+            Packet* const currentTxWakeUp = buildWakeUp(currentTxFrame, txInProgressTries);
+            setTransmitPower(currentTxWakeUp);
+            programCorrelator(currentTxFrame);
+            if(shortWakeUp){
+                emit(wakeUpEnergySavedSignal, shortWakeUpEnergySaving().get());
+            }
             send(currentTxWakeUp, wakeUpRadioOutGateId);
+#ifdef OPPOSTACK_DELAY_TRACKING
+            auto timing = currentTxFrame->addTagIfAbsent<MacTimingInd>();
+            if(timing->getFirstTryStarted() < 0){
+                timing->setFirstTryStarted(simTime());
+            }
+            timing->setWakeUpStarted(simTime());
+#endif
             txInProgressTries++;
+            txWakeUpWait = phaseLockedWakeUpWait();
+            emit(txWakeUpWaitSignal, txWakeUpWait);
+            firstRoundAckers.clear();
+            firstAckRoundHandled = false;
             txDataState = TxDataState::WAKE_UP;
             stateTxWakeUpWaitExit();
         }
@@ -263,7 +365,8 @@ bool WakeUpMacLayer::stateTxProcess(const MacEvent& event, cMessage* const msg)
             // Wake-up transmission has ended, start wait backoff for neighbors to wake-up
             changeActiveRadio(dataRadio);
             dataRadio->setRadioMode(IRadio::RADIO_MODE_SLEEP);
-            scheduleAt(simTime() + txWakeUpWaitDuration, receiveTimeout);
+            tuneDataRadio(txDataChannel);
+            scheduleAt(simTime() + txWakeUpWait, receiveTimeout);
             EV_DEBUG << "TX SM: WAKE_UP_WAIT --> DATA_WAIT";
             // Reset statistic variable counting ack rounds (from transmitter perspective)
             acknowledgmentRound = 0;
@@ -272,12 +375,159 @@ bool WakeUpMacLayer::stateTxProcess(const MacEvent& event, cMessage* const msg)
             stateTxEnterDataWait();
         }
         break;
+    case TxDataState::DATA:
+        if(event == MacEvent::TX_END){
+            ackWaitInterference = false;
+        }
+        return ORWMac::stateTxProcess(event, msg);
+    case TxDataState::ACK_WAIT:
+        if(event == MacEvent::ACK_TIMEOUT){
+            emit(ackCollisionSignal, ackWaitInterference && acknowledgedForwarders == 0);
+        }
+        if(event == MacEvent::ACK_TIMEOUT && acknowledgmentRound == 1 && !firstAckRoundHandled){
+            // Only the first data transmission after the wake-up depends on its timing and channel
+            updatePhaseLocks();
+            updateChannelFailure();
+            firstAckRoundHandled = true;
+        }
+        return ORWMac::stateTxProcess(event, msg);
     default:
         return ORWMac::stateTxProcess(event, msg);
     }
     return false;
 }
 
+simtime_t WakeUpMacLayer::phaseLockedWakeUpWait() const
+{
+    if(!phaseLocking || currentTxFrame->findTag<EqDCBroadcast>() != nullptr){
+        return txWakeUpWaitDuration;
+    }
+    auto lock = phaseLocks.find(phaseLockTarget);
+    if(lock == phaseLocks.end() || lock->second.availability < phaseLockMinAvailability){
+        return txWakeUpWaitDuration;
+    }
+    return lock->second.wakeUpWait;
+}
+
+void WakeUpMacLayer::handleForwarderAck(const Packet* const ack)
+{
+    ORWMac::handleForwarderAck(ack);
+    learnPathLoss(ack);
+    if(phaseLocking && acknowledgmentRound == 1){
+        firstRoundAckers.insert(ack->peekAtFront<ORWAck>()->getTransmitterAddress());
+    }
+}
+
+void WakeUpMacLayer::learnPathLoss(const Packet* const ack)
+{
+    const auto powerInd = ack->findTag<SignalPowerInd>();
+    if(!transmitPowerControl || powerInd == nullptr || powerInd->getPower() <= W(0)){
+        return;
+    }
+    // Acks are sent at the full data power of the same radio model
+    const double pathLoss = math::fraction2dB(dataMaxPower.get()/powerInd->getPower().get());
+    const auto ackHeader = ack->peekAtFront<ORWAck>();
+    auto result = neighborLinks.emplace(ackHeader->getTransmitterAddress(), NeighborLink());
+    NeighborLink& link = result.first->second;
+    link.pathLoss = result.second ? pathLoss : link.pathLoss + pathLossWeight*(pathLoss - link.pathLoss);
+    link.cost = ackHeader->getExpectedCostInd();
+}
+
+void WakeUpMacLayer::setTransmitPower(Packet* const wakeUp)
+{
+    W dataPower = dataMaxPower;
+    W wakeUpPower = wakeUpMaxPower;
+    if(transmitPowerControl && currentTxFrame->findTag<EqDCBroadcast>() == nullptr){
+        // Path losses to the forwarders the frame can be accepted by
+        auto required = makeShared<ORWBeacon>();
+        setBeaconFieldsFromTags(currentTxFrame, required, txInProgressTries);
+        const auto upwardsTag = currentTxFrame->findTag<EqDCUpwards>();
+        const bool upwards = upwardsTag == nullptr || upwardsTag->isUpwards();
+        std::vector<double> pathLosses;
+        size_t forwardersNeeded = powerControlForwarders;
+        const auto destination = neighborLinks.find(required->getReceiverAddress());
+        if(destination != neighborLinks.end()){
+            pathLosses.push_back(destination->second.pathLoss);
+            forwardersNeeded = 1;
+        }
+        else if(upwards){
+            for(const auto& link : neighborLinks){
+                if(link.second.cost <= required->getMinExpectedCost()){
+                    pathLosses.push_back(link.second.pathLoss);
+                }
+            }
+        }
+        if(pathLosses.size() >= forwardersNeeded){
+            std::nth_element(pathLosses.begin(), pathLosses.begin() + forwardersNeeded - 1, pathLosses.end());
+            const double pathLoss = pathLosses[forwardersNeeded - 1] + powerControlMargin
+                    + powerControlRetryStep*txInProgressTries;
+            dataPower = std::min(dataMaxPower, dataSensitivity*math::dB2fraction(pathLoss));
+            wakeUpPower = std::min(wakeUpMaxPower, wakeUpSensitivity*math::dB2fraction(pathLoss));
+        }
+    }
+    if(transmitPowerControl){
+        currentTxFrame->addTagIfAbsent<SignalPowerReq>()->setPower(dataPower);
+        wakeUp->addTagIfAbsent<SignalPowerReq>()->setPower(wakeUpPower);
+        emit(dataTxPowerSignal, dataPower.get());
+        emit(wakeUpTxPowerSignal, wakeUpPower.get());
+    }
+    auto dataTransmitter = check_and_cast<const FlatTransmitterBase *>(dataRadio->getTransmitter());
+    auto wuTransmitter = check_and_cast<const FlatTransmitterBase *>(wakeUpRadio->getTransmitter());
+    const J dataEnergy = transmitPowerConsumption(dataPower, dataMaxPower, dataTransmitPower)
+            *s(currentTxFrame->getTotalLength()/dataTransmitter->getBitrate());
+    const J wakeUpEnergy = transmitPowerConsumption(wakeUpPower, wakeUpMaxPower, wakeUpTransmitPower)
+            *s(wakeUp->getTotalLength()/wuTransmitter->getBitrate());
+    emit(txEnergyEstimateSignal, (dataEnergy + wakeUpEnergy).get());
+}
+
+W WakeUpMacLayer::transmitPowerConsumption(const W power, const W maxPower, const W maxPowerConsumption) const
+{
+    // The energy consumers draw maxPowerConsumption at any power, the radiated power saved
+    // below maxPower only reduces consumption through the power amplifier efficiency
+    const W saved = (maxPower - power)/powerAmplifierEfficiency;
+    return std::max(W(0), maxPowerConsumption - saved);
+}
+
+void WakeUpMacLayer::updatePhaseLocks()
+{
+    if(!phaseLocking || currentTxFrame == nullptr || currentTxFrame->findTag<EqDCBroadcast>() != nullptr){
+        return;
+    }
+    const bool locked = txWakeUpWait < txWakeUpWaitDuration;
+    auto target = phaseLocks.find(phaseLockTarget);
+    if(target != phaseLocks.end() && firstRoundAckers.count(phaseLockTarget) == 0){
+        target->second.availability *= 1 - phaseLockAvailabilityWeight;
+        if(locked){
+            // Missed with a shortened wait, back off towards the full wait
+            target->second.wakeUpWait = std::min(txWakeUpWaitDuration, target->second.wakeUpWait*2);
+        }
+    }
+    double bestAvailability = -1;
+    for(const auto& forwarder : firstRoundAckers){
+        auto insertion = phaseLocks.emplace(forwarder, PhaseLock());
+        PhaseLock& lock = insertion.first->second;
+        if(insertion.second){
+            lock.wakeUpWait = txWakeUpWaitDuration;
+        }
+        lock.availability = (1 - phaseLockAvailabilityWeight)*lock.availability + phaseLockAvailabilityWeight;
+        // Answered in time, try a shorter wait next time
+        lock.wakeUpWait = std::max(phaseLockMinWait, std::min(lock.wakeUpWait, txWakeUpWait - phaseLockStep));
+        if(lock.availability > bestAvailability){
+            bestAvailability = lock.availability;
+            phaseLockTarget = forwarder;
+        }
+    }
+}
+
+simtime_t WakeUpMacLayer::dataContentionWindow() const
+{
+    if(txWakeUpWaitDuration <= 0){
+        return ORWMac::dataContentionWindow();
+    }
+    // Scale down with the wake-up wait, the locked forwarder is expected to be listening already
+    return ORWMac::dataContentionWindow()*(txWakeUpWait/txWakeUpWaitDuration);
+}
+
 void WakeUpMacLayer::stateWakeUpWaitEnter()
 {
     emit(receptionStartedSignal, true);
@@ -286,8 +536,11 @@ void WakeUpMacLayer::stateWakeUpWaitEnter()
 WakeUpMacLayer::State WakeUpMacLayer::stateWakeUpWaitApproveWaitEnter(cMessage* const msg)
 {
     wuState = WuWaitState::APPROVE_WAIT;
-    scheduleAt(simTime() + wuApproveResponseLimit, receiveTimeout);
+    const simtime_t correlatorLatency = correlator != nullptr ? correlator->getMatchLatency() : SIMTIME_ZERO;
+    scheduleAt(simTime() + correlatorLatency + wuApproveResponseLimit, receiveTimeout);
     Packet* receivedData = check_and_cast<Packet*>(msg);
+    const auto beaconHeader = dynamicPtrCast<const ORWBeacon>(receivedData->peekAtFront<ORWGram>());
+    rxDataChannel = beaconHeader != nullptr ? std::min((int)beaconHeader->getDataChannel(), dataChannels - 1) : 0;
     queryWakeupRequest(receivedData);
 
     stateWakeUpWaitEnter();
@@ -308,6 +561,7 @@ WakeUpMacLayer::State WakeUpMacLayer::stateWakeUpProcess(const MacEvent& event,
             wuState = WuWaitState::DATA_RADIO_WAIT;
             changeActiveRadio(dataRadio);
             dataRadio->setRadioMode(IRadio::RADIO_MODE_SLEEP);
+            tuneDataRadio(rxDataChannel);
             cancelEvent(receiveTimeout);
             // Cancel transmit packet backoff till receive is done
             cancelEvent(transmitStartDelay); // TODO: What problem does this solve?
@@ -357,20 +611,115 @@ void WakeUpMacLayer::queryWakeupRequest(Packet* wakeUp) {
         // Approve wake-up request
         cMessage* msg = new cMessage("approve");
         msg->setKind(WAKEUP_APPROVE);
-        scheduleAt(simTime(), msg);
+        scheduleAt(simTime() + (correlator != nullptr ? correlator->getMatchLatency() : SIMTIME_ZERO), msg);
     }
     else if(datagramPreRoutingHook(wakeUp)==HookBase::Result::ACCEPT){
         acceptDataEqDCThreshold = wakeUp->getTag<EqDCReq>()->getEqDC();
         // Approve wake-up request
         cMessage* msg = new cMessage("approve");
         msg->setKind(WAKEUP_APPROVE);
-        scheduleAt(simTime(), msg);
+        scheduleAt(simTime() + (correlator != nullptr ? correlator->getMatchLatency() : SIMTIME_ZERO), msg);
+    }
+}
+
+int WakeUpMacLayer::chooseDataChannel()
+{
+    if(dataChannels <= 1){
+        return 0;
+    }
+    // Pick randomly among the least failing channels, spreading parallel transactions
+    const double leastFailure = *std::min_element(channelFailure.begin(), channelFailure.end());
+    std::vector<int> candidates;
+    for(int channel = 0; channel < dataChannels; channel++){
+        if(channelFailure[channel] <= leastFailure){
+            candidates.push_back(channel);
+        }
+    }
+    const int channel = candidates[intuniform(0, (int)candidates.size() - 1)];
+    emit(dataChannelSignal, channel);
+    return channel;
+}
+
+void WakeUpMacLayer::updateChannelFailure()
+{
+    if(dataChannels <= 1){
+        return;
+    }
+    const double failed = acknowledgedForwarders == 0 ? 1.0 : 0.0;
+    channelFailure[txDataChannel] += channelFailureWeight*(failed - channelFailure[txDataChannel]);
+}
+
+void WakeUpMacLayer::tuneDataRadio(const int channel)
+{
+    if(dataChannels <= 1){
+        return;
+    }
+    auto flatRadio = check_and_cast<physicallayer::FlatRadioBase*>(dataRadio);
+    flatRadio->setCenterFrequency(baseCenterFrequency + channelSpacing*channel);
+}
+
+bool WakeUpMacLayer::correlatorMatches(Packet* const wakeUp)
+{
+    if(correlator == nullptr){
+        return true;
+    }
+    const bool match = correlator->correlate(wakeUp->peekAtFront<ORWGram>().get());
+    if(!match){
+        EV_DEBUG << "Wake-up rejected by correlator" << endl;
+    }
+    return match;
+}
+
+void WakeUpMacLayer::programCorrelator(const Packet* const packet)
+{
+    const auto costInd = packet->findTag<EqDCInd>();
+    if(correlator != nullptr && costInd != nullptr){
+        correlator->program(networkInterface->getMacAddress(), costInd->getEqDC());
     }
 }
 
+INetfilter::IHook::Result WakeUpMacLayer::datagramPreRoutingHook(Packet* const datagram)
+{
+    const auto result = ORWMac::datagramPreRoutingHook(datagram);
+    programCorrelator(datagram);
+    return result;
+}
+
+bool WakeUpMacLayer::handleFalseWakeUp()
+{
+    Enter_Method_Silent("handleFalseWakeUp");
+    if(operationalState != OPERATING || macState != State::WAKE_UP_IDLE){
+        return false;
+    }
+    // Nothing was decoded, so accept whatever data may follow as if wake-up checking was fixed
+    acceptDataEqDCThreshold = EqDC(25.5);
+    wuState = WuWaitState::APPROVE_WAIT;
+    scheduleAt(simTime() + correlator->getMatchLatency() + wuApproveResponseLimit, receiveTimeout);
+    stateWakeUpWaitEnter();
+    cMessage* msg = new cMessage("approve");
+    msg->setKind(WAKEUP_APPROVE);
+    scheduleAt(simTime() + correlator->getMatchLatency(), msg);
+    macState = State::WAKE_UP_WAIT;
+    return true;
+}
+
 Packet* WakeUpMacLayer::buildWakeUp(const Packet *subject, const int retryCount) const{
-    auto wuHeader = makeShared<ORWBeacon>();
-    setBeaconFieldsFromTags(subject, wuHeader);
+    auto beaconHeader = makeShared<ORWBeacon>();
+    setBeaconFieldsFromTags(subject, beaconHeader, retryCount);
+    beaconHeader->setDataChannel(txDataChannel);
+    Ptr<ORWGram> wuHeader = beaconHeader;
+    if(shortWakeUp){
+        auto shortHeader = makeShared<ORWShortBeacon>();
+        shortHeader->setUpwards(beaconHeader->getUpwards());
+        shortHeader->setMinExpectedCost(beaconHeader->getMinExpectedCost());
+        const MacAddress receiverAddress = beaconHeader->getReceiverAddress();
+        shortHeader->setShortReceiverId(receiverAddress.isBroadcast() ? 0xFF : receiverAddress.getAddressByte(5));
+        shortHeader->setDataChannel(txDataChannel);
+        wuHeader = shortHeader;
+    }
+    if(dataChannels > 1){
+        wuHeader->addChunkLength(B(1));
+    }
     if(wakeUpMessageDuration > 0){
         auto wuTransmitter = check_and_cast<const FlatTransmitterBase *>(wakeUpRadio->getTransmitter());
         const bps bitrate = wuTransmitter->getBitrate();
@@ -384,6 +733,40 @@ Packet* WakeUpMacLayer::buildWakeUp(const Packet *subject, const int retryCount)
     return frame;
 }
 
+void WakeUpMacLayer::expandShortWakeUp(Packet* const wakeUp) const
+{
+    if(wakeUp->peekAtFront<ORWGram>()->getType() != ORWGramType::ORW_SHORT_BEACON){
+        return;
+    }
+    // Rebuild the fields the acceptance path checks, the transmitter stays unspecified
+    const auto shortHeader = wakeUp->removeAtFront<ORWShortBeacon>();
+    auto wuHeader = makeShared<ORWBeacon>();
+    wuHeader->setUpwards(shortHeader->getUpwards());
+    wuHeader->setMinExpectedCost(shortHeader->getMinExpectedCost());
+    wuHeader->setDataChannel(shortHeader->getDataChannel());
+    const MacAddress ownAddress = networkInterface->getMacAddress();
+    if(shortHeader->getShortReceiverId() == 0xFF){
+        wuHeader->setReceiverAddress(MacAddress::BROADCAST_ADDRESS);
+    }
+    else if(shortHeader->getShortReceiverId() == ownAddress.getAddressByte(5)){
+        // May alias another receiver, the full address in the data frame decides
+        wuHeader->setReceiverAddress(ownAddress);
+    }
+    wuHeader->setChunkLength(shortHeader->getChunkLength());
+    wakeUp->insertAtFront(wuHeader);
+}
+
+J WakeUpMacLayer::shortWakeUpEnergySaving() const
+{
+    if(not dynamicWakeUpChecking){
+        // The wake-up duration is fixed regardless of its content
+        return J(0);
+    }
+    auto wuTransmitter = check_and_cast<const FlatTransmitterBase *>(wakeUpRadio->getTransmitter());
+    const b savedLength = ORWBeacon().getChunkLength() - ORWShortBeacon().getChunkLength();
+    return wakeUpTransmitPower*s(savedLength/wuTransmitter->getBitrate());
+}
+
 void WakeUpMacLayer::stateReceiveEnterFinish() {
     // return to receive mode and only wake-up will restart reception process
     rxState = RxState::FINISH;
@@ -7,12 +7,16 @@
 #define LINKLAYER_WAKEUPMACLAYER_H_
 
 #include <omnetpp.h>
+#include <map>
+#include <set>
+#include <vector>
 #include <inet/physicallayer/wireless/common/contract/packetlevel/IRadio.h>
 #include <inet/common/Protocol.h>
 
 #include "../networklayer/ORWRouting.h"
 #include "common/Units.h"
 #include "ORWMac.h"
+#include "WakeUpCorrelator.h"
 
 namespace oppostack{
 
@@ -35,6 +39,8 @@ class WakeUpMacLayer : public ORWMac
     virtual void handleSelfMessage(cMessage *msg) override;
     using ORWMac::receiveSignal;
     virtual void receiveSignal(cComponent* source, simsignal_t signalID, intval_t value, cObject* details) override;
+    // Wake the data radio for a wake-up that was never decoded, false if not idle
+    bool handleFalseWakeUp();
 
   protected:
     /** @brief User Configured parameters */
@@ -45,6 +51,89 @@ class WakeUpMacLayer : public ORWMac
     bool fixedWakeUpChecking = false;
     bool dynamicWakeUpChecking = false;
 
+    /** @name Phase-locking to frequent forwarders */
+    /*@{*/
+    bool phaseLocking = false;
+    simtime_t phaseLockStep{0};
+    simtime_t phaseLockMinWait{0};
+    double phaseLockMinAvailability = 0.8;
+    double phaseLockAvailabilityWeight = 0.2;
+    class PhaseLock{
+    public:
+        simtime_t wakeUpWait; // Learned wait after the wake-up before the data
+        double availability = 0; // Moving average of wake-ups acknowledged in the first round
+    };
+    std::map<MacAddress, PhaseLock> phaseLocks;
+    MacAddress phaseLockTarget; // Forwarder the next wake-up is timed for
+    std::set<MacAddress> firstRoundAckers;
+    simtime_t txWakeUpWait{0}; // Wait used for the current transmission
+    bool firstAckRoundHandled = true;
+    simtime_t phaseLockedWakeUpWait() const;
+    void updatePhaseLocks();
+    virtual void handleForwarderAck(const Packet* ack) override;
+    virtual simtime_t dataContentionWindow() const override;
+    static simsignal_t txWakeUpWaitSignal;
+    /*@}*/
+
+    /** @name Short wake-up format */
+    /*@{*/
+    bool shortWakeUp = false;
+    W wakeUpTransmitPower{0}; // Transmitting power consumption of the wake-up radio, 0 if unknown
+    void expandShortWakeUp(Packet* wakeUp) const;
+    J shortWakeUpEnergySaving() const;
+    static simsignal_t wakeUpEnergySavedSignal;
+    /*@}*/
+
+    /** @name Multi-channel data */
+    /*@{*/
+    int dataChannels = 1;
+    Hz baseCenterFrequency{0};
+    Hz channelSpacing{0};
+    double channelFailureWeight = 0.1;
+    std::vector<double> channelFailure; // Moving average of unacknowledged first data transmissions
+    int txDataChannel = 0;
+    int rxDataChannel = 0;
+    bool ackWaitInterference = false;
+    int chooseDataChannel();
+    void updateChannelFailure();
+    void tuneDataRadio(int channel);
+    static simsignal_t dataChannelSignal;
+    static simsignal_t ackCollisionSignal;
+    /*@}*/
+
+    /** @name Per neighbor transmit power control */
+    /*@{*/
+    bool transmitPowerControl = false;
+    int powerControlForwarders = 2;
+    double powerControlMargin = 6; // dB
+    double powerControlRetryStep = 3; // dB
+    double pathLossWeight = 0.3;
+    W dataMaxPower{0};
+    W wakeUpMaxPower{0};
+    W dataSensitivity{0};
+    W wakeUpSensitivity{0};
+    class NeighborLink{
+    public:
+        double pathLoss = 0; // dB, moving average
+        ExpectedCost cost{255}; // Last cost indicated in its acks
+    };
+    std::map<MacAddress, NeighborLink> neighborLinks;
+    double powerAmplifierEfficiency = 0.3;
+    W dataTransmitPower{0}; // Transmitting power consumption of the data radio at dataMaxPower, 0 if unknown
+    void learnPathLoss(const Packet* ack);
+    void setTransmitPower(Packet* wakeUp);
+    W transmitPowerConsumption(const W power, const W maxPower, const W maxPowerConsumption) const;
+    static simsignal_t dataTxPowerSignal;
+    static simsignal_t wakeUpTxPowerSignal;
+    static simsignal_t txEnergyEstimateSignal;
+    /*@}*/
+
+    /** @brief Optional wake-up receiver correlator */
+    WakeUpCorrelator* correlator{nullptr};
+    bool correlatorMatches(Packet* wakeUp);
+    void programCorrelator(const Packet* packet);
+    virtual inet::INetfilter::IHook::Result datagramPreRoutingHook(inet::Packet* datagram) override;
+
     // TODO: Replace by type to represent accept, reject messages
     const int WAKEUP_APPROVE = 502;
     const int WAKEUP_REJECT = 503;
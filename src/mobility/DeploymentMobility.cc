@@ -0,0 +1,30 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include <inet/common/ModuleAccess.h>
+#include "DeploymentMobility.h"
+#include "DeploymentPlanner.h"
+#include "common/oppDefs.h"
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace oppostack {
+
+Define_Module(DeploymentMobility);
+
+void DeploymentMobility::setInitialPosition()
+{
+    // Planner positions are generated in INITSTAGE_LOCAL, before any mobility stage
+    auto planner = check_and_cast<DeploymentPlanner*>(getCModuleFromPar(par("plannerModule"), this));
+    if(par("hub")){
+        lastPosition = planner->getHubPosition(par("hubIndex"));
+    }
+    else{
+        lastPosition = planner->getNodePosition(getContainingNode(this)->getIndex());
+    }
+}
+
+} /* namespace oppostack */
@@ -0,0 +1,21 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef MOBILITY_DEPLOYMENTMOBILITY_H_
+#define MOBILITY_DEPLOYMENTMOBILITY_H_
+
+#include <inet/mobility/base/StationaryMobilityBase.h>
+
+namespace oppostack {
+
+class DeploymentMobility : public inet::StationaryMobilityBase
+{
+  protected:
+    virtual void setInitialPosition() override;
+};
+
+} /* namespace oppostack */
+
+#endif /* MOBILITY_DEPLOYMENTMOBILITY_H_ */
@@ -0,0 +1,143 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "DeploymentPlanner.h"
+#include <cmath>
+#include <cstring>
+
+using namespace omnetpp;
+using namespace inet;
+
+namespace oppostack {
+
+Define_Module(DeploymentPlanner);
+
+void DeploymentPlanner::initialize()
+{
+    areaWidth = par("areaWidth");
+    areaHeight = par("areaHeight");
+    const int numNodes = par("numNodes");
+    if(numNodes < 0 || areaWidth <= 0 || areaHeight <= 0){
+        throw cRuntimeError("Invalid deployment of %i nodes over %gm x %gm", numNodes, areaWidth, areaHeight);
+    }
+    nodePositions.reserve(numNodes);
+    const char* deployment = par("deployment");
+    if(strcmp(deployment, "grid") == 0){
+        generateGrid(numNodes);
+    }
+    else if(strcmp(deployment, "uniform") == 0){
+        generateUniform(numNodes);
+    }
+    else if(strcmp(deployment, "poissonCluster") == 0){
+        generatePoissonCluster(numNodes);
+    }
+    else{
+        throw cRuntimeError("Unknown deployment \"%s\"", deployment);
+    }
+    const int numHubs = par("numHubs");
+    if(numHubs < 1){
+        throw cRuntimeError("Deployment needs at least one hub, numHubs = %i", numHubs);
+    }
+    placeHubs(par("hubPlacement"), numHubs);
+}
+
+const Coord& DeploymentPlanner::getNodePosition(int index) const
+{
+    if(index < 0 || index >= (int)nodePositions.size()){
+        throw cRuntimeError("No deployment position for node index %i", index);
+    }
+    return nodePositions[index];
+}
+
+const Coord& DeploymentPlanner::getHubPosition(int index) const
+{
+    if(index < 0 || index >= (int)hubPositions.size()){
+        throw cRuntimeError("No deployment position for hub index %i", index);
+    }
+    return hubPositions[index];
+}
+
+void DeploymentPlanner::generateGrid(int numNodes)
+{
+    if(numNodes == 0)return;
+    // Keep cells close to square for non square areas
+    const int columns = std::max(1, (int)std::ceil(std::sqrt(numNodes * areaWidth / areaHeight)));
+    const int rows = (numNodes + columns - 1) / columns;
+    const double dx = areaWidth / columns;
+    const double dy = areaHeight / rows;
+    for(int i = 0; i < numNodes; i++){
+        nodePositions.push_back(Coord((i % columns + 0.5) * dx, (i / columns + 0.5) * dy, 0));
+    }
+}
+
+void DeploymentPlanner::generateUniform(int numNodes)
+{
+    for(int i = 0; i < numNodes; i++){
+        const double x = uniform(0, areaWidth);
+        const double y = uniform(0, areaHeight);
+        nodePositions.push_back(Coord(x, y, 0));
+    }
+}
+
+void DeploymentPlanner::generatePoissonCluster(int numNodes)
+{
+    // Thomas cluster process conditioned on the node count: parents uniform
+    // over the area, each node joins a random parent with a gaussian offset
+    const double meanClusterSize = par("meanClusterSize");
+    const double clusterRadius = par("clusterRadius");
+    if(meanClusterSize <= 0){
+        throw cRuntimeError("meanClusterSize must be positive");
+    }
+    const int numClusters = std::max(1, (int)std::lround(numNodes / meanClusterSize));
+    std::vector<Coord> clusterCentres;
+    clusterCentres.reserve(numClusters);
+    for(int i = 0; i < numClusters; i++){
+        const double x = uniform(0, areaWidth);
+        const double y = uniform(0, areaHeight);
+        clusterCentres.push_back(Coord(x, y, 0));
+    }
+    for(int i = 0; i < numNodes; i++){
+        const Coord& centre = clusterCentres[intuniform(0, numClusters - 1)];
+        const double x = std::min(areaWidth, std::max(0.0, centre.x + normal(0, clusterRadius)));
+        const double y = std::min(areaHeight, std::max(0.0, centre.y + normal(0, clusterRadius)));
+        nodePositions.push_back(Coord(x, y, 0));
+    }
+}
+
+void DeploymentPlanner::placeHubs(const char* placement, int numHubs)
+{
+    hubPositions.clear();
+    if(strcmp(placement, "spread") == 0){
+        // Hubs at the cell centres of a grid over the area, as in generateGrid()
+        const int columns = std::max(1, (int)std::ceil(std::sqrt(numHubs * areaWidth / areaHeight)));
+        const int rows = (numHubs + columns - 1) / columns;
+        const double dx = areaWidth / columns;
+        const double dy = areaHeight / rows;
+        for(int i = 0; i < numHubs; i++){
+            hubPositions.push_back(Coord((i % columns + 0.5) * dx, (i / columns + 0.5) * dy, 0));
+        }
+        return;
+    }
+    if(strcmp(placement, "centre") == 0){
+        hubPositions.push_back(Coord(areaWidth / 2, areaHeight / 2, 0));
+    }
+    else if(strcmp(placement, "edge") == 0){
+        hubPositions.push_back(Coord(areaWidth / 2, 0, 0));
+    }
+    else if(strcmp(placement, "corner") == 0){
+        hubPositions.push_back(Coord(0, 0, 0));
+    }
+    else if(strcmp(placement, "random") != 0){
+        throw cRuntimeError("Unknown hub placement \"%s\"", placement);
+    }
+    // Any further hubs are placed at random
+    while((int)hubPositions.size() < numHubs){
+        const double x = uniform(0, areaWidth);
+        const double y = uniform(0, areaHeight);
+        hubPositions.push_back(Coord(x, y, 0));
+    }
+}
+
+} /* namespace oppostack */
@@ -0,0 +1,35 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef MOBILITY_DEPLOYMENTPLANNER_H_
+#define MOBILITY_DEPLOYMENTPLANNER_H_
+
+#include <omnetpp.h>
+#include <inet/common/geometry/common/Coord.h>
+#include <vector>
+
+namespace oppostack {
+
+class DeploymentPlanner : public omnetpp::cSimpleModule
+{
+  public:
+    const inet::Coord& getNodePosition(int index) const;
+    const inet::Coord& getHubPosition(int index = 0) const;
+  protected:
+    std::vector<inet::Coord> nodePositions;
+    std::vector<inet::Coord> hubPositions;
+    double areaWidth{0.0};
+    double areaHeight{0.0};
+
+    virtual void initialize() override;
+    virtual void generateGrid(int numNodes);
+    virtual void generateUniform(int numNodes);
+    virtual void generatePoissonCluster(int numNodes);
+    virtual void placeHubs(const char* placement, int numHubs);
+};
+
+} /* namespace oppostack */
+
+#endif /* MOBILITY_DEPLOYMENTPLANNER_H_ */
@@ -0,0 +1,491 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "DisseminationManager.h"
+#include <inet/common/IProtocolRegistrationListener.h>
+#include <inet/common/ModuleAccess.h>
+#include <inet/common/ProtocolGroup.h>
+#include <inet/common/ProtocolTag_m.h>
+#include <inet/common/packet/chunk/ByteCountChunk.h>
+#include <inet/networklayer/common/L3AddressResolver.h>
+#include <inet/networklayer/common/L3AddressTag_m.h>
+#include <cmath>
+#include <cstring>
+
+#include "common/EqDCTag_m.h"
+
+using namespace inet;
+using namespace oppostack;
+
+Define_Module(DisseminationManager);
+
+simsignal_t DisseminationManager::disseminationDelaySignal = cComponent::registerSignal("disseminationDelay");
+simsignal_t DisseminationManager::chunkSentSignal = cComponent::registerSignal("chunkSent");
+simsignal_t DisseminationManager::chunkRequestSentSignal = cComponent::registerSignal("chunkRequestSent");
+simsignal_t DisseminationManager::summarySentSignal = cComponent::registerSignal("summarySent");
+simsignal_t DisseminationManager::summarySuppressedSignal = cComponent::registerSignal("summarySuppressed");
+
+const inet::Protocol oppostack::Dissemination("dissemination", "Dissemination");
+
+void DisseminationManager::initialize(int stage)
+{
+    ApplicationBase::initialize(stage);
+    if(stage == INITSTAGE_LOCAL){
+        const char* mode = par("mode");
+        if(strcmp(mode, "unicast") == 0){
+            unicastMode = true;
+        }
+        else if(strcmp(mode, "trickle") != 0){
+            throw cRuntimeError("Unknown dissemination mode \"%s\"", mode);
+        }
+        origin = par("origin");
+        const int id = par("objectId");
+        if(id < 0 || id > 255)
+            throw cRuntimeError("objectId must be between 0 and 255");
+        objectId = id;
+        objectSize = B(par("objectSize"));
+        chunkSize = B(par("chunkSize"));
+        publishInterval = par("publishInterval");
+        chunkInterval = par("chunkInterval");
+        requestDelay = par("requestDelay");
+        requestTimeout = par("requestTimeout");
+        if(chunkSize <= B(0))
+            throw cRuntimeError("chunkSize must be positive");
+        const double chunkCount = std::ceil(objectSize.get()/chunkSize.get());
+        if(origin && (chunkCount < 1 || chunkCount > 64))
+            throw cRuntimeError("objectSize must be 1 to 64 chunks of chunkSize");
+
+        publishTimer = new cMessage("dissemination publish");
+        chunkTimer = new cMessage("dissemination chunk");
+        requestTimer = new cMessage("dissemination request");
+        if(!unicastMode){
+            trickle = new TrickleTimer(this, par("trickleMinInterval").doubleValue(),
+                    par("trickleDoublings").intValue(), par("trickleRedundancy").intValue());
+        }
+        if(ProtocolGroup::ipprotocol.findProtocolNumber(&Dissemination) < 0){
+            ProtocolGroup::ipprotocol.addProtocol(par("protocol"), &Dissemination);
+        }
+    }
+    else if(stage == INITSTAGE_APPLICATION_LAYER){
+        registerService(Dissemination, nullptr, gate("ipIn"));
+        registerProtocol(Dissemination, gate("ipOut"), nullptr);
+    }
+}
+
+void DisseminationManager::handleMessageWhenUp(cMessage* const msg)
+{
+    if(trickle != nullptr && trickle->isTrickleTimer(msg)){
+        handleTrickleTimer(msg);
+    }
+    else if(msg == publishTimer){
+        publish();
+    }
+    else if(msg == chunkTimer){
+        sendNextChunk();
+    }
+    else if(msg == requestTimer){
+        sendRequests();
+    }
+    else{
+        auto packet = check_and_cast<Packet*>(msg);
+        const auto header = packet->popAtFront<DisseminationHeader>();
+        if(header->getType() == DISSEMINATION_REQUEST){
+            handleRequest(header);
+        }
+        else{
+            handleChunk(header, packet->getDataLength());
+        }
+        delete packet;
+    }
+}
+
+void DisseminationManager::handleStartOperation(LifecycleOperation* const operation)
+{
+    if(origin && !publishTimer->isScheduled()){
+        if(objects.count(objectId) == 0){
+            const simtime_t publishTime = par("publishTime");
+            scheduleAt(std::max(simTime(), publishTime), publishTimer);
+        }
+        else if(publishInterval > 0){
+            scheduleAt(simTime() + publishInterval, publishTimer);
+        }
+    }
+    // Neighbors may have moved on while off, so advertise from the minimum interval
+    startTrickle();
+    scheduleRequest();
+    scheduleChunkTimer();
+}
+
+void DisseminationManager::handleStopOperation(LifecycleOperation* const operation)
+{
+    cancelEvent(publishTimer);
+    cancelEvent(chunkTimer);
+    cancelEvent(requestTimer);
+    if(trickle != nullptr){
+        trickle->stop();
+    }
+}
+
+void DisseminationManager::handleCrashOperation(LifecycleOperation* const operation)
+{
+    handleStopOperation(operation);
+    // Objects are kept in non-volatile memory, only the transfer state is lost
+    pendingChunks.clear();
+    unicastChunks.clear();
+    newerDataHeard = false;
+}
+
+void DisseminationManager::publish()
+{
+    auto& object = objects[objectId];
+    const int chunkCount = std::ceil(objectSize.get()/chunkSize.get());
+    object.version++;
+    object.chunkLengths.assign(chunkCount, chunkSize);
+    object.chunkLengths.back() = objectSize - chunkSize*(chunkCount - 1);
+    object.chunksHeld = chunkCount;
+    object.publishTime = simTime();
+    EV_INFO << "Publishing version " << object.version << " of object " << (int)objectId
+            << " in " << chunkCount << " chunks" << endl;
+    for(auto pending = pendingChunks.begin(); pending != pendingChunks.end();){
+        pending = pending->first == objectId ? pendingChunks.erase(pending) : std::next(pending);
+    }
+    if(unicastMode){
+        if(unicastDestinations.empty()){
+            unicastDestinations = findUnicastDestinations();
+        }
+        for(const auto& destination : unicastDestinations){
+            for(int i = 0; i < chunkCount; i++){
+                unicastChunks.emplace_back(destination, i);
+            }
+        }
+        scheduleChunkTimer();
+    }
+    else{
+        // Neighbors learn of the new version from the next summary
+        resetTrickle();
+    }
+    if(publishInterval > 0){
+        scheduleAt(simTime() + publishInterval, publishTimer);
+    }
+}
+
+DisseminationManager::DataObject& DisseminationManager::adoptVersion(const uint8_t id, const uint16_t version,
+        const int chunkCount)
+{
+    auto& object = objects[id];
+    if(object.version != version || (int)object.chunkLengths.size() != chunkCount){
+        object.version = version;
+        object.chunkLengths.assign(chunkCount, B(0));
+        object.chunksHeld = 0;
+        object.publishTime = 0;
+        // Chunks of the old version are no longer served
+        for(auto pending = pendingChunks.begin(); pending != pendingChunks.end();){
+            pending = pending->first == id ? pendingChunks.erase(pending) : std::next(pending);
+        }
+    }
+    return object;
+}
+
+DisseminationSummaryExt* DisseminationManager::buildSummary() const
+{
+    if(unicastMode || objects.empty()){
+        return nullptr;
+    }
+    auto summary = new DisseminationSummaryExt();
+    for(const auto& entry : objects){
+        summary->insertObjectId(entry.first);
+        summary->insertVersion(entry.second.version);
+        summary->insertChunkCount(entry.second.chunkLengths.size());
+        summary->insertComplete(entry.second.isComplete());
+    }
+    summary->setLength(2 + DisseminationSummaryExt::entryLength*objects.size());
+    return summary;
+}
+
+void DisseminationManager::handleSummary(const L3Address& source, const DisseminationSummaryExt* const summary)
+{
+    Enter_Method("handleSummary");
+    if(!isUp() || unicastMode){
+        return;
+    }
+    bool consistent = true;
+    bool inconsistent = false;
+    std::set<uint8_t> advertised;
+    for(size_t i = 0; i < summary->getObjectIdArraySize(); i++){
+        const uint8_t id = summary->getObjectId(i);
+        const uint16_t version = summary->getVersion(i);
+        const int chunkCount = summary->getChunkCount(i);
+        advertised.insert(id);
+        if(chunkCount < 1 || chunkCount > 64){
+            continue;
+        }
+        const auto existing = objects.find(id);
+        if(existing == objects.end() || isNewerVersion(version, existing->second.version)){
+            EV_INFO << source << " advertised version " << version << " of object " << (int)id << endl;
+            adoptVersion(id, version, chunkCount);
+            newerDataHeard = newerDataHeard || summary->getComplete(i);
+            inconsistent = true;
+        }
+        else if(version != existing->second.version){
+            // Neighbor behind, it requests once it hears the newer version
+            inconsistent = true;
+        }
+        else if(summary->getComplete(i) != existing->second.isComplete()){
+            newerDataHeard = newerDataHeard || summary->getComplete(i);
+            consistent = false;
+        }
+    }
+    for(const auto& entry : objects){
+        inconsistent = inconsistent || advertised.count(entry.first) == 0;
+    }
+    if(inconsistent){
+        resetTrickle();
+    }
+    else if(consistent && trickle->isRunning()){
+        trickle->hearConsistent();
+    }
+    scheduleRequest();
+}
+
+void DisseminationManager::handleRequest(const Ptr<const DisseminationHeader>& header)
+{
+    const auto existing = objects.find(header->getObjectId());
+    if(existing == objects.end() || isNewerVersion(header->getVersion(), existing->second.version)){
+        // The requester heard of a version this node has not, its own summaries follow
+        return;
+    }
+    const auto& object = existing->second;
+    if(object.version != header->getVersion()){
+        resetTrickle();
+        return;
+    }
+    for(size_t i = 0; i < object.chunkLengths.size(); i++){
+        if((header->getRequestedChunks() >> i & 1) && object.chunkLengths[i] > B(0)){
+            pendingChunks.emplace(header->getObjectId(), i);
+        }
+    }
+    scheduleChunkTimer();
+}
+
+void DisseminationManager::handleChunk(const Ptr<const DisseminationHeader>& header, const B length)
+{
+    const uint8_t id = header->getObjectId();
+    const uint8_t index = header->getChunkIndex();
+    const auto existing = objects.find(id);
+    if(existing != objects.end() && isNewerVersion(existing->second.version, header->getVersion())){
+        // Neighbor serving an old version, advertise the newer one soon
+        resetTrickle();
+        return;
+    }
+    if(header->getChunkCount() < 1 || header->getChunkCount() > 64 || index >= header->getChunkCount()){
+        EV_WARN << "Discarding chunk " << (int)index << " of " << (int)header->getChunkCount() << endl;
+        return;
+    }
+    if(existing == objects.end() || existing->second.version != header->getVersion()){
+        adoptVersion(id, header->getVersion(), header->getChunkCount());
+        resetTrickle();
+    }
+    auto& object = objects[id];
+    // Another holder served this chunk, no need to send it again
+    pendingChunks.erase(std::make_pair(id, index));
+    if(object.chunkLengths[index] > B(0)){
+        return;
+    }
+    object.chunkLengths[index] = length;
+    object.chunksHeld++;
+    object.publishTime = header->getPublishTime();
+    newerDataHeard = true;
+    if(object.isComplete()){
+        EV_INFO << "Completed version " << object.version << " of object " << (int)id << endl;
+        emit(disseminationDelaySignal, simTime() - object.publishTime);
+        // Let neighbors behind know this node can now serve them
+        resetTrickle();
+    }
+    scheduleRequest();
+}
+
+void DisseminationManager::handleTrickleTimer(cMessage* const msg)
+{
+    switch(trickle->handleTimer(msg)){
+        case TrickleTimer::Event::TRANSMIT:
+            if(summaryAdvertised){
+                // A hello already carried the summary this interval
+                emit(summarySuppressedSignal, 1);
+            }
+            else{
+                sendSummary();
+            }
+            break;
+        case TrickleTimer::Event::SUPPRESS:
+            emit(summarySuppressedSignal, 1);
+            break;
+        case TrickleTimer::Event::INTERVAL_END:
+            summaryAdvertised = false;
+            break;
+        case TrickleTimer::Event::NONE:
+            break;
+    }
+}
+
+void DisseminationManager::startTrickle()
+{
+    if(trickle != nullptr && !objects.empty()){
+        summaryAdvertised = false;
+        trickle->start();
+    }
+}
+
+void DisseminationManager::resetTrickle()
+{
+    if(trickle == nullptr){
+        return;
+    }
+    if(!trickle->isRunning()){
+        startTrickle();
+    }
+    else if(trickle->reset()){
+        summaryAdvertised = false;
+    }
+}
+
+void DisseminationManager::scheduleRequest()
+{
+    if(unicastMode || requestTimer->isScheduled()){
+        return;
+    }
+    for(const auto& entry : objects){
+        if(!entry.second.isComplete()){
+            // Random delay so neighbors missing the same chunks rarely request together
+            scheduleAt(simTime() + uniform(0, requestDelay), requestTimer);
+            return;
+        }
+    }
+}
+
+void DisseminationManager::sendRequests()
+{
+    bool incomplete = false;
+    for(const auto& entry : objects){
+        const auto& object = entry.second;
+        if(object.isComplete()){
+            continue;
+        }
+        incomplete = true;
+        if(!newerDataHeard){
+            // No holder heard since the last request, wait for its summary
+            continue;
+        }
+        auto header = makeShared<DisseminationHeader>();
+        header->setType(DISSEMINATION_REQUEST);
+        header->setObjectId(entry.first);
+        header->setVersion(object.version);
+        header->setChunkCount(object.chunkLengths.size());
+        uint64_t missing = 0;
+        for(size_t i = 0; i < object.chunkLengths.size(); i++){
+            if(object.chunkLengths[i] == B(0)){
+                missing |= (uint64_t)1 << i;
+            }
+        }
+        header->setRequestedChunks(missing);
+        header->addChunkLength(B(8));
+        emit(chunkRequestSentSignal, 1);
+        sendLinkLocal(new Packet("Dissemination request", header));
+    }
+    newerDataHeard = false;
+    if(incomplete){
+        scheduleAt(simTime() + requestTimeout, requestTimer);
+    }
+}
+
+void DisseminationManager::scheduleChunkTimer()
+{
+    if(!chunkTimer->isScheduled() && (!pendingChunks.empty() || !unicastChunks.empty())){
+        // Random so several holders answering one request rarely send the same chunk
+        scheduleAt(simTime() + uniform(0, chunkInterval), chunkTimer);
+    }
+}
+
+void DisseminationManager::sendNextChunk()
+{
+    if(!unicastChunks.empty()){
+        const auto next = unicastChunks.front();
+        unicastChunks.pop_front();
+        sendUnicast(buildChunk(objectId, next.second), next.first);
+    }
+    else if(!pendingChunks.empty()){
+        const auto next = *pendingChunks.begin();
+        pendingChunks.erase(pendingChunks.begin());
+        sendLinkLocal(buildChunk(next.first, next.second));
+    }
+    else{
+        return;
+    }
+    emit(chunkSentSignal, 1);
+    scheduleChunkTimer();
+}
+
+void DisseminationManager::sendSummary()
+{
+    // Empty link-local broadcast, ORWRouting attaches the summary
+    emit(summarySentSignal, 1);
+    sendLinkLocal(new Packet("Dissemination summary"));
+}
+
+Packet* DisseminationManager::buildChunk(const uint8_t id, const uint8_t index) const
+{
+    const auto& object = objects.at(id);
+    ASSERT(index < object.chunkLengths.size() && object.chunkLengths[index] > B(0));
+    auto header = makeShared<DisseminationHeader>();
+    header->setType(DISSEMINATION_DATA);
+    header->setObjectId(id);
+    header->setVersion(object.version);
+    header->setChunkCount(object.chunkLengths.size());
+    header->setChunkIndex(index);
+    header->setPublishTime(object.publishTime);
+    auto packet = new Packet("Dissemination chunk", header);
+    packet->insertAtBack(makeShared<ByteCountChunk>(object.chunkLengths[index]));
+    return packet;
+}
+
+void DisseminationManager::sendLinkLocal(Packet* const packet)
+{
+    packet->addTag<PacketProtocolTag>()->setProtocol(&Dissemination);
+    packet->addTag<DispatchProtocolReq>()->setProtocol(&Protocol::nextHopForwarding);
+    packet->addTag<L3AddressReq>()->setDestAddress(L3Address());
+    packet->addTag<LinkLocalReq>();
+    packet->addTag<EqDCBroadcast>();
+    packet->addTag<EqDCReq>()->setEqDC(EqDC(25.5)); // Set to accept any forwarder
+    send(packet, "ipOut");
+}
+
+void DisseminationManager::sendUnicast(Packet* const packet, const L3Address& destination)
+{
+    packet->addTag<PacketProtocolTag>()->setProtocol(&Dissemination);
+    packet->addTag<DispatchProtocolReq>()->setProtocol(&Protocol::nextHopForwarding);
+    packet->addTag<L3AddressReq>()->setDestAddress(destination);
+    send(packet, "ipOut");
+}
+
+std::vector<L3Address> DisseminationManager::findUnicastDestinations() const
+{
+    // Every other node with a dissemination manager, as a hub that knows the deployment would
+    std::vector<L3Address> destinations;
+    for(int id = 0; id <= getSimulation()->getLastComponentId(); id++){
+        auto manager = dynamic_cast<DisseminationManager*>(getSimulation()->getModule(id));
+        if(manager != nullptr && manager != this){
+            destinations.push_back(L3AddressResolver().addressOf(getContainingNode(manager),
+                    L3AddressResolver::ADDR_MODULEPATH));
+        }
+    }
+    return destinations;
+}
+
+DisseminationManager::~DisseminationManager()
+{
+    delete trickle;
+    cancelAndDelete(publishTimer);
+    cancelAndDelete(chunkTimer);
+    cancelAndDelete(requestTimer);
+}
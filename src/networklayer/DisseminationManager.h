@@ -0,0 +1,113 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef NETWORKLAYER_DISSEMINATIONMANAGER_H_
+#define NETWORKLAYER_DISSEMINATIONMANAGER_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <inet/applications/base/ApplicationBase.h>
+#include <inet/common/Protocol.h>
+#include <inet/networklayer/common/L3Address.h>
+
+#include "common/TrickleTimer.h"
+#include "Dissemination_m.h"
+
+namespace oppostack {
+
+extern const inet::Protocol Dissemination;
+
+/**
+ * Network wide dissemination of version numbered data objects (configuration,
+ * firmware) in chunks, after Deluge. Summaries of the held versions are
+ * advertised on a Trickle timer, piggybacked on empty link-local broadcasts.
+ * Neighbors behind request the missing chunks, and any neighbor holding them
+ * serves them as link-local broadcasts.
+ * The unicast mode instead sends every chunk from the origin to every node,
+ * as a baseline for the completion time and energy.
+ */
+class DisseminationManager : public inet::ApplicationBase
+{
+public:
+    static omnetpp::simsignal_t disseminationDelaySignal;
+    static omnetpp::simsignal_t chunkSentSignal;
+    static omnetpp::simsignal_t chunkRequestSentSignal;
+    static omnetpp::simsignal_t summarySentSignal;
+    static omnetpp::simsignal_t summarySuppressedSignal;
+
+    // Summary of the held versions for ORWRouting to piggyback, nullptr when nothing is held
+    DisseminationSummaryExt* buildSummary() const;
+    void handleSummary(const inet::L3Address& source, const DisseminationSummaryExt* summary);
+    void notifySummaryPiggybacked() {summaryAdvertised = true;};
+
+    ~DisseminationManager();
+protected:
+    class DataObject{
+    public:
+        uint16_t version{0};
+        std::vector<inet::B> chunkLengths; // B(0) for chunks not held
+        int chunksHeld{0};
+        omnetpp::simtime_t publishTime{0};
+        bool isComplete() const {return chunksHeld == (int)chunkLengths.size();};
+    };
+    std::map<uint8_t, DataObject> objects;
+
+    bool unicastMode{false};
+    bool origin{false};
+    uint8_t objectId{0};
+    inet::B objectSize{0};
+    inet::B chunkSize{0};
+    omnetpp::simtime_t publishInterval{0};
+    omnetpp::simtime_t chunkInterval{0};
+    omnetpp::simtime_t requestDelay{0};
+    omnetpp::simtime_t requestTimeout{0};
+
+    TrickleTimer* trickle{nullptr};
+    bool summaryAdvertised{false};
+    omnetpp::cMessage* publishTimer{nullptr};
+    omnetpp::cMessage* chunkTimer{nullptr};
+    omnetpp::cMessage* requestTimer{nullptr};
+    // Chunks to broadcast, as object id and chunk index
+    std::set<std::pair<uint8_t, uint8_t>> pendingChunks;
+    // Unicast mode chunks still to send from the origin, as destination and chunk index
+    std::deque<std::pair<inet::L3Address, uint8_t>> unicastChunks;
+    std::vector<inet::L3Address> unicastDestinations;
+    // A neighbor advertised or served chunks this node is missing since the last request
+    bool newerDataHeard{false};
+
+    virtual int numInitStages() const override {return inet::NUM_INIT_STAGES;};
+    virtual void initialize(int stage) override;
+    virtual void handleMessageWhenUp(omnetpp::cMessage* msg) override;
+    virtual void handleStartOperation(inet::LifecycleOperation* operation) override;
+    virtual void handleStopOperation(inet::LifecycleOperation* operation) override;
+    virtual void handleCrashOperation(inet::LifecycleOperation* operation) override;
+
+    static bool isNewerVersion(const uint16_t version, const uint16_t than){
+        return static_cast<int16_t>(static_cast<uint16_t>(version - than)) > 0;
+    };
+    void publish();
+    DataObject& adoptVersion(const uint8_t id, const uint16_t version, const int chunkCount);
+    void handleTrickleTimer(omnetpp::cMessage* msg);
+    void handleChunk(const inet::Ptr<const DisseminationHeader>& header, const inet::B length);
+    void handleRequest(const inet::Ptr<const DisseminationHeader>& header);
+    void startTrickle();
+    void resetTrickle();
+    void scheduleRequest();
+    void scheduleChunkTimer();
+    void sendNextChunk();
+    void sendRequests();
+    void sendSummary();
+    inet::Packet* buildChunk(const uint8_t id, const uint8_t index) const;
+    void sendLinkLocal(inet::Packet* packet);
+    void sendUnicast(inet::Packet* packet, const inet::L3Address& destination);
+    std::vector<inet::L3Address> findUnicastDestinations() const;
+};
+
+} /* namespace oppostack */
+
+#endif /* NETWORKLAYER_DISSEMINATIONMANAGER_H_ */
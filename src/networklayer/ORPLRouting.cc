@@ -11,8 +11,6 @@
 #include <inet/networklayer/common/L3AddressTag_m.h>
 #include "../common/EqDCTag_m.h"
 #include "RoutingSetExt_m.h"
-#include <inet/networklayer/nexthop/NextHopRoute.h>
-#include "../common/Util.h"
 #include <set>
 
 using namespace oppostack;
@@ -70,6 +68,12 @@ void ORPLRouting::checkDownwardsRoutableAndTag(const inet::L3Address& destAddr,
     }
 }
 
+bool ORPLRouting::isDownwardRoutable(const inet::L3Address& destination) const
+{
+    auto routingTable = check_and_cast<ORPLRoutingTable*>(this->routingTable);
+    return routingTable->calculateDownwardsCost(destination) < EqDC(25.5);
+}
+
 void ORPLRouting::handleUpperPacket(Packet* const packet)
 {
     // Assign downwards routing tags if address downwards routable
@@ -105,35 +109,9 @@ std::set<L3Address> ORPLRouting::getSharingRoutingSet() const
 {
     // Only get the routing set that should be shared, excluding some directly connected nodes
     auto routingTable = check_and_cast<ORPLRoutingTable*>(this->routingTable);
-    size_t knownDestsCount = routingTable->getNumRoutes();
-    // Might be smaller but guaranteed not to exceed knownDests size
-    std::set<L3Address> sharingRoutingSet;
-    std::set<L3Address> excludedRoutingSet;
     // TODO: Should forwarding cost be included in minDownwardsMetric?
     EqDC minDownwardsMetric = routingTable->calculateUpwardsCost(rootAddress);
-    for (int i = 0; i < knownDestsCount; i++) {
-        // TODO: get destRoute directly from routing table with getRoute
-        std::pair<L3Address, int> destinationExpectedCostPair = routingTable->getRoute(i);
-        NextHopRoute destRoute;
-        destRoute.setDestination(destinationExpectedCostPair.first);
-        destRoute.setMetric(destinationExpectedCostPair.second);
-        // TODO: Replace EqDC(0.2) with forwardingCostW value
-        if (ExpectedCost(destRoute.getMetric()) >= minDownwardsMetric + routingTable->getForwardingCost()) {
-            // add to the end of sharingRoutingSet and increment size
-            sharingRoutingSet.insert(destRoute.getDestinationAsGeneric());
-            if (contains(excludedRoutingSet, destRoute.getDestinationAsGeneric())) {
-                EV_ERROR << "Node appears in both excluded set and sharing set. Potential routing loop.";
-            }
-        }
-        else // else exclude neighbor from sharing set as not downwards
-        {
-            excludedRoutingSet.insert(destRoute.getDestinationAsGeneric());
-            if (contains(sharingRoutingSet, destRoute.getDestinationAsGeneric())) {
-                EV_ERROR << "Node appears in both excluded set and sharing set. Potential routing loop.";
-            }
-        }
-    }
-    return sharingRoutingSet;
+    return routingTable->getSharingRoutingSet(minDownwardsMetric + routingTable->getForwardingCost());
 }
 
 void ORPLRouting::setDownControlInfo(Packet* const packet, const MacAddress& macMulticast, const EqDC& costIndicator, const EqDC& onwardCost) const
@@ -141,7 +119,9 @@ void ORPLRouting::setDownControlInfo(Packet* const packet, const MacAddress& mac
     // TODO: Add routingSetExt TlvOption header occasionally
     bool isBroadcast = packet->findTag<EqDCBroadcast>() != nullptr;
     double addRoutingSetRand = uniform(0,1);
-    if(isBroadcast && addRoutingSetRand < routingSetBroadcastProportion || addRoutingSetRand < routingSetProportion){
+    // Fragments are sized to the MTU, leaving no room for the routing set
+    const bool isFragment = packet->peekAtFront<OpportunisticRoutingHeader>()->isFragment();
+    if(!isFragment && (isBroadcast && addRoutingSetRand < routingSetBroadcastProportion || addRoutingSetRand < routingSetProportion)){
         // Only get the routing set that should be shared, excluding some directly connected nodes
         std::set<L3Address> sharingRoutingSet = getSharingRoutingSet();
         // Insert routing set into routingSetExt header if there are neighboring nodes.
@@ -30,6 +30,8 @@ private:
     void handleLowerPacket(Packet* const packet) override;
     void setDownControlInfo(Packet* const packet, const MacAddress& macMulticast, const EqDC& costIndicator, const EqDC& onwardCost) const override;
     std::set<L3Address> getSharingRoutingSet() const;
+    bool supportsDownwardRouting() const override {return true;};
+    bool isDownwardRoutable(const inet::L3Address& destination) const override;
 };
 
 } /* namespace oppostack */
@@ -74,8 +74,8 @@ EqDC ORPLRoutingTable::calculateUpwardsCost(const inet::L3Address destination) c
     if(interface->getNetworkAddress() == destination){
         return EqDC(0.0);
     }
-    else if(interface->getNetworkAddress() == rootAddress && destination != rootAddress){
-        // This node is the root and the destination is not the root return minimum cost
+    else if(isHubAddress(interface->getNetworkAddress()) && !isHubAddress(destination)){
+        // This node is a root and the destination is not a root return minimum cost
         // As packet will be accepted but not delivered here
         if(forwardingCostW < EqDC(0.1)){
             return ExpectedCost(EqDC(0.1));
@@ -93,36 +93,24 @@ EqDC ORPLRoutingTable::calculateDownwardsCost(const inet::L3Address& destination
 {
     Enter_Method("ORPLRoutingTable::calculateDownwardsCost(address)");
 
-    EqDC ownEqDCEstimate = calculateCostToRoot();
-
-    // Utility functions
-    // TODO: Clarify if checking both recentInteractionProb and node.interactionsTotal is problematic
-    // When is recentInteractionProb == 0 but interactionsTotal > 2
-    auto isNeighborEntryActive = [=](const NeighborEntry node)
-        {return node.recentInteractionProb > 0 || node.interactionsTotal > 2;};
-    auto isNeighborEntryDownwards = [=](const NeighborEntry node)
-        {return node.lastEqDC >= ownEqDCEstimate;};
-
-    const auto& immediateNeighbor = encountersTable.find(destination);
-    const auto& downwardsSetNode = routingSetTable.find(destination);
     const NetworkInterface* interface = interfaceTable->findFirstNonLoopbackInterface();
     if(interface->getNetworkAddress() == destination){
         return EqDC(0.0);
     }
-    else if(immediateNeighbor != encountersTable.end() && isNeighborEntryActive(immediateNeighbor->second) && isNeighborEntryDownwards(immediateNeighbor->second)){
-        if(forwardingCostW <= EqDC(0.1)){
-            return EqDC(0.1);
-        }
-        return EqDC(forwardingCostW);
-    }
-    else if(downwardsSetNode != routingSetTable.end() && isNeighborEntryActive(downwardsSetNode->second)){
-        if(forwardingCostW <= EqDC(0.1)){
-            return 2.0*EqDC(0.1);
-        }
-        return 2.0*EqDC(forwardingCostW);
+    const EqDC hopCost = std::max(forwardingCostW, EqDC(0.1));
+    return routing::downwardsCost(routingSetTable, encountersTable, destination, calculateCostToRoot(), hopCost, EqDC(25.5));
+}
+
+std::set<L3Address> ORPLRoutingTable::getSharingRoutingSet(const EqDC minDownwardsCost) const
+{
+    std::set<L3Address> sharingRoutingSet;
+    std::set<L3Address> excludedRoutingSet;
+    // Compare on the quantised cost that is shared with neighbors
+    auto isDownwards = [&](const EqDC cost){return ExpectedCost(cost) >= minDownwardsCost;};
+    if(routing::sharingRoutingSet(routingSetTable, encountersTable, isDownwards, sharingRoutingSet, excludedRoutingSet) > 0){
+        EV_ERROR << "Node appears in both excluded set and sharing set. Potential routing loop.";
     }
-    const EqDC estimatedCost = EqDC(25.5);
-    return ExpectedCost(estimatedCost);
+    return sharingRoutingSet;
 }
 
 INetfilter::IHook::Result ORPLRoutingTable::datagramPreRoutingHook(Packet* datagram)
@@ -236,38 +224,7 @@ void ORPLRoutingTable::receiveSignal(cComponent* source, omnetpp::simsignal_t si
 
 int ORPLRoutingTable::countDownwardNodes(const EqDC ownEqDCEstimate) const
 {
-    int downwardsSetSize = 0;
-
-    // Utility functions
-    auto isNeighborEntryActive = [=](const NeighborEntry node)
-        {return node.recentInteractionProb > 0;};
-    auto isNeighborEntryDownwards = [=](const NeighborEntry node)
-        {return node.lastEqDC >= ownEqDCEstimate;};
-
-    // Loop through merged downward set from neighbour
-    for (const auto& nodePair : routingSetTable) {
-        const auto nodeEntry = nodePair.second;
-        // Only count active downward routing set entries
-        if (isNeighborEntryActive(nodeEntry) && isNeighborEntryDownwards(nodeEntry)) {
-            auto encountersTblRes = encountersTable.find(nodePair.first);
-            if (encountersTblRes != encountersTable.end() && isNeighborEntryActive(encountersTblRes->second)) {
-            //if (encountersTblRes != encountersTable.end() && isNeighborEntryActive(encountersTable[node.first])) {
-                // Node is active immediate neighbor so don't count here, count with encountersTable neighbors
-            }
-            else {
-                // Node not encountersTable neighbour so count from routing set
-                downwardsSetSize++;
-            }
-        }
-    }
-    // loop through encountersTable
-    for (const auto& nodePair : encountersTable) {
-        const auto node = nodePair.second;
-        if (isNeighborEntryActive(node) && isNeighborEntryDownwards(node)) {
-            downwardsSetSize++;
-        }
-    }
-    return downwardsSetSize;
+    return routing::countDownwardNodes(routingSetTable, encountersTable, ownEqDCEstimate);
 }
 
 void ORPLRoutingTable::printRoutingTable()
@@ -319,9 +276,23 @@ void ORPLRoutingTable::printRoutingTable()
     EV << "-------------------------" << endl;
 }
 
+void ORPLRoutingTable::writeRoutingState(std::ostream& os) const
+{
+    ORWRoutingTable::writeRoutingState(os);
+    writeNeighborRecords(os, "r", routingSetTable);
+}
+
+bool ORPLRoutingTable::readRoutingStateRecord(const std::string& type, std::istream& fields)
+{
+    if(type == "r"){
+        return readNeighborRecord(fields, routingSetTable);
+    }
+    return ORWRoutingTable::readRoutingStateRecord(type, fields);
+}
+
 void ORPLRoutingTable::finish()
 {
-    cComponent::finish();
+    ORWRoutingTable::finish();
     if((bool)par("printRoutingTables")){
         EV_INFO << "Node " << interfaceTable->getHostModule()->getName() << endl;
         printRoutingTable();
@@ -10,6 +10,7 @@
 #include "inet/networklayer/common/L3Address.h"
 #include "inet/networklayer/contract/IRoute.h"
 #include "OpportunisticRoutingHeader_m.h"
+#include <set>
 
 namespace oppostack {
 
@@ -28,6 +29,8 @@ private:
 
 protected:
     void initialize(int stage) override;
+    virtual void writeRoutingState(std::ostream& os) const override;
+    virtual bool readRoutingStateRecord(const std::string& type, std::istream& fields) override;
     virtual void receiveSignal(cComponent *source, omnetpp::simsignal_t signalID, cObject* msg, cObject *details) override;
 public:
     // Like interfaces from IRoutingTable
@@ -38,6 +41,8 @@ public:
     // Useful for checking if in range or via another node
     // TODO: replace with IRoute*
     virtual std::pair<const inet::L3Address ,int > getRoute(int k);
+    // Active routes at least minDownwardsCost from the root, to share with neighbors
+    std::set<inet::L3Address> getSharingRoutingSet(const EqDC minDownwardsCost) const;
 
     virtual void activateWarmUpRoutingData() override;
     EqDC calculateUpwardsCost(const inet::L3Address destination) const override;
@@ -10,28 +10,96 @@
 #include <inet/networklayer/contract/IL3AddressType.h>
 #include <inet/common/ModuleAccess.h>
 #include "ORWHello.h"
+#include "ORWRoutingTable.h"
+#include "linklayer/ILinkOverhearingSource.h"
+#include <algorithm>
 
 using namespace inet;
 using namespace oppostack;
 Define_Module(ORWHello);
 
+simsignal_t ORWHello::helloSuppressedSignal = cComponent::registerSignal("helloSuppressed");
+simsignal_t ORWHello::trickleResetSignal = cComponent::registerSignal("trickleReset");
+simsignal_t ORWHello::trickleConvergenceTimeSignal = cComponent::registerSignal("trickleConvergenceTime");
+
+ORWHello::~ORWHello()
+{
+    delete trickle;
+}
+
 void ORWHello::initialize(int const stage)
 {
     IpvxTrafGen::initialize(stage);
 
     if(stage == INITSTAGE_LOCAL){
-        sentMessageQueue = check_and_cast<queueing::IPacketQueue *>(getSubmodule("destinationRecord"));
+        const int recordCapacity = par("destinationRecordCapacity");
+        ASSERT(recordCapacity > 0);
+        sentRecords.resize(recordCapacity);
         minTransmissionProbability = par("intermittentPacketRate");
         ASSERT(minTransmissionProbability > 0 && minTransmissionProbability < 1);
         packetSourceModule = getCModuleFromPar(par("packetSignalSourceModule"), this, true);
+        if(par("trickle")){
+            trickle = new TrickleTimer(this, par("trickleMinInterval").doubleValue(),
+                    par("trickleDoublings").intValue(), par("trickleRedundancy").intValue());
+        }
     }
     else if(stage == INITSTAGE_NETWORK_LAYER){
         packetSourceModule->subscribe(packetSentToLowerSignal, this);
+        if(trickle != nullptr){
+            cModule* encountersModule = getCModuleFromPar(par("encountersSourceModule"), this);
+            encountersModule->subscribe(ILinkOverhearingSource::coincidentalEncounterSignal, this);
+            encountersModule->subscribe(ORWRoutingTable::neighborhoodChangedSignal, this);
+        }
     }
 
 
 }
 
+void ORWHello::handleMessageWhenUp(cMessage* msg)
+{
+    if(trickle != nullptr && trickle->isTrickleTimer(msg)){
+        handleTrickleTimer(msg);
+    }
+    else{
+        IpvxTrafGen::handleMessageWhenUp(msg);
+    }
+}
+
+void ORWHello::scheduleNextPacket(simtime_t previous)
+{
+    if(trickle == nullptr || previous == -1){
+        IpvxTrafGen::scheduleNextPacket(previous);
+    }
+    else if(!trickle->isRunning()){
+        // First hello sent (destinations resolved), Trickle now sets the rate
+        trickle->start();
+        lastTrickleReset = simTime();
+        trickleConverged = false;
+    }
+}
+
+void ORWHello::handleTrickleTimer(cMessage* msg)
+{
+    switch(trickle->handleTimer(msg)){
+        case TrickleTimer::Event::TRANSMIT:
+            if(!destAddresses.empty()){
+                sendPacket();
+            }
+            break;
+        case TrickleTimer::Event::SUPPRESS:
+            emit(helloSuppressedSignal, 1);
+            break;
+        case TrickleTimer::Event::INTERVAL_END:
+            if(!trickleConverged && trickle->isAtMaxInterval()){
+                trickleConverged = true;
+                emit(trickleConvergenceTimeSignal, simTime() - lastTrickleReset);
+            }
+            break;
+        case TrickleTimer::Event::NONE:
+            break;
+    }
+}
+
 L3Address ORWHello::chooseDestAddr()
 {
     return quietestDestination().second;
@@ -51,7 +119,6 @@ void ORWHello::sendPacket()
         EV_ERROR << "ORPLHello may not behave properly with more than 3 destinations";
 
     const L3Address destAddr = chooseDestAddr();
-    ASSERT(destAddr == destAddresses[0]);
     const IL3AddressType *addressType = destAddr.getAddressType();
     pkt->addTag<PacketProtocolTag>()->setProtocol(protocol);
     pkt->addTag<DispatchProtocolReq>()->setProtocol(addressType->getNetworkProtocol());
@@ -64,6 +131,15 @@ void ORWHello::sendPacket()
     numSent++;
 }
 
+void ORWHello::startApp()
+{
+    IpvxTrafGen::startApp();
+    // Hubs form a single anycast root, a hello addressed to the first reaches any of them
+    if(destAddresses.size() > 1){
+        destAddresses.resize(1);
+    }
+}
+
 void ORWHello::handleStartOperation(inet::LifecycleOperation* op)
 {
     onOffCycles++;
@@ -72,13 +148,18 @@ void ORWHello::handleStartOperation(inet::LifecycleOperation* op)
         startApp();
         return;
     }
+    if(trickle != nullptr){
+        // State may be stale after being off, so restart from the minimum interval
+        trickle->start();
+        lastTrickleReset = simTime();
+        trickleConverged = false;
+        return;
+    }
 
     scheduleNextPacket(simTime());
-    const int queueSize = sentMessageQueue->getNumPackets();
-    int numCycles = 0;
-    if(queueSize>0){
-        const int firstRecordedCycle = sentMessageQueue->getPacket(0)->peekAtFront<OpportunisticRoutingHeader>()->getId();
-        numCycles = onOffCycles - firstRecordedCycle;
+    if(sentRecordCount>0){
+        const int firstRecordedCycle = sentRecords[sentRecordStart].cycle;
+        const int numCycles = onOffCycles - firstRecordedCycle;
         const int transmissionsExpected = minTransmissionProbability*(numCycles);
         if(quietestDestination().first<=transmissionsExpected){
             sendPacket();
@@ -86,47 +167,94 @@ void ORWHello::handleStartOperation(inet::LifecycleOperation* op)
     }
 }
 
+void ORWHello::handleStopOperation(LifecycleOperation* op)
+{
+    if(trickle != nullptr){
+        trickle->stop();
+    }
+    IpvxTrafGen::handleStopOperation(op);
+}
+
+void ORWHello::handleCrashOperation(LifecycleOperation* op)
+{
+    if(trickle != nullptr){
+        trickle->stop();
+    }
+    IpvxTrafGen::handleCrashOperation(op);
+}
+
 std::pair<int, inet::L3Address> ORWHello::quietestDestination() const
 {
-    const int k = 0;
     ASSERT(!destAddresses.empty());
-    inet::L3Address quietestAddress = destAddresses[k];
-
-    const int queueSize = sentMessageQueue->getNumPackets();
-    int quietestCount = queueSize;
-    // Not efficient with large numbers of destinations but there should be <=3 anyway!
-    for(auto &helloDest : destAddresses){
-        int destinationCount =0;
-        for(int i=0; i<queueSize; i++){
-            const Packet* recordedMessage = sentMessageQueue->getPacket(i);
-            const L3Address destAddr = recordedMessage->peekAtFront<OpportunisticRoutingHeader>()->getDestAddr();
-            if(destAddr == helloDest){
-                destinationCount++;
-            }
-        }
+    inet::L3Address quietestAddress = destAddresses[0];
+    int quietestCount = sentRecordCount;
+    for(size_t i=0; i<destAddresses.size(); i++){
+        const int destinationCount = i < sentPerDestination.size() ? sentPerDestination[i] : 0;
         if(destinationCount<quietestCount){
             quietestCount = destinationCount;
-            quietestAddress = helloDest;
+            quietestAddress = destAddresses[i];
         }
     }
     return std::pair<int, inet::L3Address>(quietestCount, quietestAddress);
 }
 
+void ORWHello::recordSent(const L3Address& destAddr)
+{
+    // Destinations are resolved on start, so the counters follow them
+    if(sentPerDestination.size() != destAddresses.size()){
+        sentPerDestination.assign(destAddresses.size(), 0);
+        for(size_t i=0; i<sentRecordCount; i++){
+            auto& record = sentRecords[(sentRecordStart + i) % sentRecords.size()];
+            if(record.destIndex >= (int)destAddresses.size()){
+                record.destIndex = -1;
+            }
+            if(record.destIndex >= 0){
+                sentPerDestination[record.destIndex]++;
+            }
+        }
+    }
+    const auto destIt = std::find(destAddresses.begin(), destAddresses.end(), destAddr);
+    const int destIndex = destIt == destAddresses.end() ? -1 : destIt - destAddresses.begin();
+
+    if(sentRecordCount == sentRecords.size()){
+        // Full, drop the oldest record
+        const int droppedIndex = sentRecords[sentRecordStart].destIndex;
+        if(droppedIndex >= 0){
+            sentPerDestination[droppedIndex]--;
+        }
+        sentRecordStart = (sentRecordStart + 1) % sentRecords.size();
+        sentRecordCount--;
+    }
+    sentRecords[(sentRecordStart + sentRecordCount) % sentRecords.size()] = {onOffCycles, destIndex};
+    sentRecordCount++;
+    if(destIndex >= 0){
+        sentPerDestination[destIndex]++;
+    }
+}
+
 void ORWHello::receiveSignal(cComponent* source, omnetpp::simsignal_t signalID, cObject* msg, cObject* details)
 {
     if(signalID == packetSentToLowerSignal){
-        // Extract destination to new header
         Packet* sentPacket = check_and_cast<Packet*>(msg);
-        auto sentHeader = sentPacket->peekAtFront<OpportunisticRoutingHeader>();
-
-        auto packetRecord = makeShared<OpportunisticRoutingHeader>();
-        packetRecord->setId(onOffCycles); // Reuse ID for what cycle packet transmitted in
-        //TODO: Make plural when relevant
-        packetRecord->setDestAddr(sentHeader->getDestAddr());
-        auto pkt = new Packet("PacketLog");
-        pkt->insertAtFront(packetRecord);
-
-        sentMessageQueue->enqueuePacket(pkt);
+        recordSent(sentPacket->peekAtFront<OpportunisticRoutingHeader>()->getDestAddr());
     }
 }
 
+void ORWHello::receiveSignal(cComponent* source, omnetpp::simsignal_t signalID, double value, cObject* details)
+{
+    Enter_Method_Silent();
+    if(trickle == nullptr || !isUp()){
+        return;
+    }
+    if(signalID == ILinkOverhearingSource::coincidentalEncounterSignal){
+        // Overheard neighbor traffic advertises its EqDC as well as a hello would
+        trickle->hearConsistent();
+    }
+    else if(signalID == ORWRoutingTable::neighborhoodChangedSignal){
+        if(trickle->reset()){
+            lastTrickleReset = simTime();
+            trickleConverged = false;
+            emit(trickleResetSignal, 1);
+        }
+    }
+}
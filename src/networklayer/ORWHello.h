@@ -8,8 +8,9 @@
 
 #include <omnetpp.h>
 #include <inet/applications/generic/IpvxTrafGen.h>
-#include <inet/queueing/contract/IPacketQueue.h>
+#include <vector>
 #include "OpportunisticRoutingHeader_m.h"
+#include "common/TrickleTimer.h"
 
 namespace oppostack{
 
@@ -20,22 +21,48 @@ class ORWHello : public inet::IpvxTrafGen, public inet::cListener
 {
 public:
     ORWHello() : inet::IpvxTrafGen(),
-        sentMessageQueue(nullptr),
         packetSourceModule(nullptr){};
+    virtual ~ORWHello();
 protected:
     virtual void initialize(int stage) override;
+    virtual void handleMessageWhenUp(omnetpp::cMessage* msg) override;
+    virtual void scheduleNextPacket(omnetpp::simtime_t previous) override;
 
+    virtual void startApp() override;
     virtual inet::L3Address chooseDestAddr() override;
     virtual void sendPacket();
 
     virtual void handleStartOperation(inet::LifecycleOperation* op) override;
+    virtual void handleStopOperation(inet::LifecycleOperation* op) override;
+    virtual void handleCrashOperation(inet::LifecycleOperation* op) override;
 protected:
     double minTransmissionProbability = 0;
-    inet::queueing::IPacketQueue* sentMessageQueue;
     omnetpp::cModule* packetSourceModule;
     int onOffCycles = 0;
 
+    // Ring buffer of the most recently sent packets, oldest at sentRecordStart
+    struct SentRecord{
+        int cycle; // onOffCycles when sent
+        int destIndex; // Index in destAddresses, -1 if not a hello destination
+    };
+    std::vector<SentRecord> sentRecords;
+    size_t sentRecordStart = 0;
+    size_t sentRecordCount = 0;
+    // Number of sentRecords for each of destAddresses
+    std::vector<int> sentPerDestination;
+    void recordSent(const inet::L3Address& destAddr);
+
     virtual void receiveSignal(cComponent *source, omnetpp::simsignal_t signalID, cObject* msg, cObject *details) override;
+    virtual void receiveSignal(cComponent *source, omnetpp::simsignal_t signalID, double value, cObject *details) override;
+
+    // Optional Trickle control of hello transmissions, replaces sendInterval
+    TrickleTimer* trickle{nullptr};
+    omnetpp::simtime_t lastTrickleReset{0};
+    bool trickleConverged{false};
+    static omnetpp::simsignal_t helloSuppressedSignal;
+    static omnetpp::simsignal_t trickleResetSignal;
+    static omnetpp::simsignal_t trickleConvergenceTimeSignal;
+    void handleTrickleTimer(omnetpp::cMessage* msg);
 
     std::pair<int, inet::L3Address> quietestDestination() const;
 };
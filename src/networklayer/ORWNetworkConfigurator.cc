@@ -13,10 +13,12 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
+#include <inet/common/INETMath.h>
 #include <inet/physicallayer/wireless/common/base/packetlevel/NarrowbandTransmitterBase.h>
 #include "ORWNetworkConfigurator.h"
 #include "../linklayer/ORWMacInterface.h"
 #include "ORWRoutingTable.h"
+#include "RoutingAlgorithms.h"
 #include <math.h>
 
 using namespace inet;
@@ -48,64 +50,222 @@ Hz ORWNetworkConfigurator::computeAppTotalLoad(const cModule *nodeModule) const
     return 1.0 / s(packetSource->par("sendInterval"));
 }
 
-unit ORWNetworkConfigurator::computeHopsEstimate(const Coord rootPosition, const m maxRange, const Node *sourceNode) const {
+Coord ORWNetworkConfigurator::getNearestHubPosition(const Coord nodePosition) const {
+    ASSERT(!hubPositions.empty());
+    Coord nearestPosition = hubPositions.front();
+    for (const auto& hubPosition : hubPositions) {
+        if (nodePosition.sqrdist(hubPosition) < nodePosition.sqrdist(nearestPosition))
+            nearestPosition = hubPosition;
+    }
+    return nearestPosition;
+}
+
+unit ORWNetworkConfigurator::computeHopsEstimate(const m maxRange, const Node *sourceNode) const {
     const auto nodeInterfaces = sourceNode->interfaceTable;
     const ORWMacInterface *primaryInterface = getFirstORWInterface(nodeInterfaces);
     const IRadio *initialContactRadio = primaryInterface->getInitiationRadio();
     Coord targetPosition =
             initialContactRadio->getAntenna()->getMobility()->getCurrentPosition();
-    const m distance { rootPosition.distance(targetPosition) };
+    const m distance { getNearestHubPosition(targetPosition).distance(targetPosition) };
     const unit hops { std::max(1.0, unit(distance / maxRange).get() / sqrt(2)) };
     return hops;
 }
 
-Hz ORWNetworkConfigurator::computeNodeLoadContribution(const Coord rootPosition, const Node* sourceNode, const m maxRange) const
+Hz ORWNetworkConfigurator::computeNodeLoadContribution(const Node* sourceNode, const m maxRange) const
 {
-    const unit hops = computeHopsEstimate(rootPosition, maxRange, sourceNode);
+    const unit hops = computeHopsEstimate(maxRange, sourceNode);
     const cModule* nodeModule = sourceNode->getModule();
     Hz load{computeAppTotalLoad(nodeModule)};
     return load*hops;
 }
 
-EqDC ORWNetworkConfigurator::estimatePerNodeEqDC(const Coord rootPosition, const Node* node, const Hz loadEstimate, const m maxRange) const{
+EqDC ORWNetworkConfigurator::estimatePerNodeEqDC(const Node* node, const Hz loadEstimate, const m maxRange) const{
     const auto host = node->getModule();
-    const unit hops = computeHopsEstimate(rootPosition, maxRange, node);
+    const unit hops = computeHopsEstimate(maxRange, node);
     //TODO: Replace with call to NextHopNetowrkConfigurator::findRoutingTable()
     auto routingTable = dynamic_cast<ORWRoutingTable *>(host->findModuleByPath(".generic.routingTable"));
     return routingTable->estimateEqDC(loadEstimate, hops);
 }
 
+void ORWNetworkConfigurator::extractNetwork(){
+    if(networkExtracted){
+        return;
+    }
+    networkExtracted = true;
+    // extract topology into the Topology object, then fill in a LinkInfo[] vector
+    extractTopology(topology);
+    radioMedium = check_and_cast<IRadioMedium *>(getParentModule()->getSubmodule("radioMedium"));
+    const auto hubAddresses = ORWRoutingTable::resolveHubAddresses(par("hubAddress"));
+    if(hubAddresses.empty()){
+        throw cRuntimeError("No hub found in hubAddress \"%s\"", par("hubAddress").stringValue());
+    }
+    hubPositions.clear();
+    hubs.clear();
+    const IRadio* rootInitiationRadio{nullptr};
+    for(const auto& hubAddress : hubAddresses){
+        cModule* hub = L3AddressResolver().findHostWithAddress(hubAddress);
+        IInterfaceTable* hubInterfaces = L3AddressResolver().interfaceTableOf(hub);
+        const IRadio* hubInitiationRadio = getFirstORWInterface(hubInterfaces)->getInitiationRadio();
+        hubPositions.push_back(hubInitiationRadio->getAntenna()->getMobility()->getCurrentPosition());
+        hubs.insert(hub);
+        if(routingHub == nullptr){
+            routingHub = hub;
+            rootInitiationRadio = hubInitiationRadio;
+        }
+    }
+    auto* narrowbandTransmitter = check_and_cast<const NarrowbandTransmitterBase *>(
+                                            rootInitiationRadio->getTransmitter());
+    maxRange = computeMaxRange( narrowbandTransmitter->getCenterFrequency(), 1.0,
+                                rootInitiationRadio->getReceiver()->getMinReceptionPower(),
+                                rootInitiationRadio->getTransmitter()->getMaxPower() );
+}
+
+Hz ORWNetworkConfigurator::estimatePerNodeLoad() const{
+    Hz networkLoadEstimate{0};
+    for (int i = 0; i < topology.getNumNodes(); i++) {
+        Node* sourceNode = (Node *)topology.getNode(i);
+        networkLoadEstimate += computeNodeLoadContribution(sourceNode, maxRange);
+    }
+    return networkLoadEstimate/topology.getNumNodes();
+}
+
 void ORWNetworkConfigurator::initialize(int stage){
     NextHopNetworkConfigurator::initialize(stage);
     if(stage == INITSTAGE_NETWORK_CONFIGURATION && par("estimateInitialEqDC")){
-        // extract topology into the Topology object, then fill in a LinkInfo[] vector
-        extractTopology(topology);
-        radioMedium = check_and_cast<IRadioMedium *>(getParentModule()->getSubmodule("radioMedium"));
-        const char* rootParameter = par("hubAddress");
-        L3Address rootAddress;
-        L3AddressResolver().tryResolve(rootParameter, rootAddress, L3AddressResolver::ADDR_MODULEPATH);
-        routingHub = L3AddressResolver().findHostWithAddress(rootAddress);
-
-        IInterfaceTable* rootInterfaces = L3AddressResolver().interfaceTableOf(routingHub);
-        const ORWMacInterface* rootORWInterface = getFirstORWInterface(rootInterfaces);
-        const IRadio* rootInitiationRadio = rootORWInterface->getInitiationRadio();
-        Coord rootPosition = rootInitiationRadio->getAntenna()->getMobility()->getCurrentPosition();
-        auto* narrowbandTransmitter = check_and_cast<const NarrowbandTransmitterBase *>(
-                                                rootInitiationRadio->getTransmitter());
-        m maxRange = computeMaxRange( narrowbandTransmitter->getCenterFrequency(), 1.0,
-                                      rootInitiationRadio->getReceiver()->getMinReceptionPower(),
-                                      rootInitiationRadio->getTransmitter()->getMaxPower() );
-        Hz networkLoadEstimate{0};
-        for (int i = 0; i < topology.getNumNodes(); i++) {
-            Node* sourceNode = (Node *)topology.getNode(i);
-            networkLoadEstimate += computeNodeLoadContribution(rootPosition, sourceNode, maxRange);
-        }
-        const Hz perNodeLoadEstimate = networkLoadEstimate/topology.getNumNodes();
+        extractNetwork();
+        const Hz perNodeLoadEstimate = estimatePerNodeLoad();
         for (int i = 0; i < topology.getNumNodes(); i++) {
             Node* node= (Node *)topology.getNode(i);
-            estimatePerNodeEqDC(rootPosition, node, perNodeLoadEstimate, maxRange);
+            estimatePerNodeEqDC(node, perNodeLoadEstimate, maxRange);
+        }
+    }
+}
+
+W ORWNetworkConfigurator::getBackgroundNoisePower() const{
+    const cModule* backgroundNoise = dynamic_cast<const cModule*>(radioMedium->getBackgroundNoise());
+    if(backgroundNoise == nullptr || backgroundNoise->findPar("power") < 0){
+        return W(0);
+    }
+    return mW(math::dBmW2mW(backgroundNoise->par("power").doubleValueInUnit("dBm")));
+}
+
+double ORWNetworkConfigurator::oracleLinkProbability(const IRadio* transmitterRadio, const IRadio* receiverRadio, const W noisePower) const{
+    // Received power from the radio medium path loss, with unity antenna gains as in computeMaxRange()
+    const auto* narrowbandTransmitter = check_and_cast<const NarrowbandTransmitterBase *>(transmitterRadio->getTransmitter());
+    const m distance{transmitterRadio->getAntenna()->getMobility()->getCurrentPosition().distance(
+                        receiverRadio->getAntenna()->getMobility()->getCurrentPosition())};
+    const double pathLoss = radioMedium->getPathLoss()->computePathLoss(
+            radioMedium->getPropagation()->getPropagationSpeed(), narrowbandTransmitter->getCenterFrequency(), distance);
+    const W receptionPower = narrowbandTransmitter->getMaxPower()*pathLoss;
+    const IReceiver* receiver = receiverRadio->getReceiver();
+    if(receptionPower < receiver->getMinReceptionPower()){
+        return 0;
+    }
+    if(noisePower <= W(0)){
+        return 1;
+    }
+    const double snir = unit(receptionPower/noisePower).get();
+    const cModule* receiverModule = check_and_cast<const cModule*>(receiver);
+    if(receiverModule->findPar("snirThreshold") >= 0
+            && snir < math::dB2fraction(receiverModule->par("snirThreshold").doubleValueInUnit("dB"))){
+        return 0;
+    }
+    // IEEE 802.15.4 O-QPSK bit error rate, every bit of the frame must be received
+    double bitErrorRate = 0;
+    double binomial = 16; // C(16,1)
+    for(int k = 2; k <= 16; k++){
+        binomial *= (16.0 - k + 1)/k;
+        bitErrorRate += ((k % 2 == 0) ? 1 : -1)*binomial*exp(20.0*snir*(1.0/k - 1.0));
+    }
+    bitErrorRate = std::min(0.5, std::max(0.0, bitErrorRate*8.0/15.0/16.0));
+    return pow(1.0 - bitErrorRate, b(B(par("oracleFrameLength").intValue())).get());
+}
+
+void ORWNetworkConfigurator::computeOracleEqDC(){
+    extractNetwork();
+    const Hz perNodeLoadEstimate = estimatePerNodeLoad();
+    const W noisePower = getBackgroundNoisePower();
+    const int numNodes = topology.getNumNodes();
+    std::vector<const IRadio*> radios(numNodes, nullptr);
+    std::vector<double> dutyCycles(numNodes, 1.0);
+    std::vector<EqDC> forwardingCosts(numNodes, EqDC(0.0));
+    std::vector<EqDC> costs(numNodes, EqDC(25.5));
+    std::vector<bool> settled(numNodes, false);
+    for (int i = 0; i < numNodes; i++) {
+        const Node* node = (Node *)topology.getNode(i);
+        const ORWMacInterface* interface = getFirstORWInterface(node->interfaceTable);
+        if(interface == nullptr){
+            // Not part of the opportunistic network
+            settled[i] = true;
+            continue;
+        }
+        radios[i] = interface->getInitiationRadio();
+        const bool isHub = hubs.find(node->getModule()) != hubs.end();
+        auto routingTable = dynamic_cast<RoutingTableBase *>(node->getModule()->findModuleByPath(".generic.routingTable"));
+        if(routingTable != nullptr){
+            forwardingCosts[i] = routingTable->getForwardingCost();
+            if(!isHub){
+                // Forwarders are awake with the duty cycle estimateEqDC() assumes
+                dutyCycles[i] = routingTable->estimateDutyCycle(perNodeLoadEstimate).get();
+            }
+        }
+        if(isHub){
+            costs[i] = EqDC(0.0);
+        }
+    }
+
+    // Settle nodes in increasing cost as in Dijkstra. Forwarders join a node's
+    // forwarding set in the same order, so each update only adds the cheapest
+    // remaining forwarder, as costToRoot() would.
+    class OracleEntry{
+    public:
+        EqDC lastEqDC;
+        double recentInteractionProb;
+    };
+    std::vector<std::vector<std::pair<int, OracleEntry>>> forwarders(numNodes);
+    routing::CostProbabilityPairs<EqDC> pairs;
+    auto unreachable = [](){return EqDC(25.5);};
+    while(true){
+        int next = -1;
+        for (int i = 0; i < numNodes; i++) {
+            if(!settled[i] && (next < 0 || costs[i] < costs[next])){
+                next = i;
+            }
+        }
+        if(next < 0 || costs[next] >= EqDC(25.5)){
+            break;
         }
+        settled[next] = true;
+        for (int i = 0; i < numNodes; i++) {
+            if(settled[i]){
+                continue;
+            }
+            const double probability = dutyCycles[next]*oracleLinkProbability(radios[i], radios[next], noisePower);
+            if(probability <= 0){
+                continue;
+            }
+            forwarders[i].emplace_back(next, OracleEntry{costs[next], probability});
+            const EqDC cost = routing::costToRoot(forwarders[i], unreachable, EqDC(25.5), pairs) + forwardingCosts[i];
+            costs[i] = std::min(costs[i], cost);
+        }
+    }
+
+    oracleCosts.clear();
+    for (int i = 0; i < numNodes; i++) {
+        oracleCosts[topology.getNode(i)->getModule()] = std::min(costs[i], EqDC(25.5));
+    }
+}
+
+EqDC ORWNetworkConfigurator::getOracleEqDC(const cModule* host){
+    Enter_Method("getOracleEqDC");
+    if(oracleCosts.empty()){
+        computeOracleEqDC();
+    }
+    const auto entry = oracleCosts.find(host);
+    if(entry == oracleCosts.end()){
+        throw cRuntimeError("Host %s not found in the network topology", host->getFullPath().c_str());
     }
+    return entry->second;
 }
 
 m ORWNetworkConfigurator::computeMaxRange(const Hz frequency, const double antennaGain, const W receptionPower, const W transmissionPower) const{
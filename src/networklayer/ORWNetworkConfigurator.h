@@ -19,26 +19,44 @@
 #include <inet/networklayer/configurator/nexthop/NextHopNetworkConfigurator.h>
 #include <inet/physicallayer/wireless/common/contract/packetlevel/IRadioMedium.h>
 #include <inet/common/Units.h>
+#include <map>
+#include <set>
+#include <vector>
 #include "common/Units.h"
 #include "linklayer/ORWMacInterface.h"
 
 namespace oppostack {
 
 class ORWNetworkConfigurator: public inet::NextHopNetworkConfigurator {
+public:
+    // Optimal EqDC of the host given global knowledge of positions and links, see OracleRoutingTable
+    EqDC getOracleEqDC(const cModule* host);
 protected:
     const inet::physicallayer::IRadioMedium *radioMedium{nullptr};
     cModule* routingHub{nullptr};
+    std::vector<inet::Coord> hubPositions; // Nodes estimate their cost relative to the nearest hub
+    std::set<const cModule*> hubs;
+    inet::m maxRange{0};
+    bool networkExtracted{false};
+    std::map<const cModule*, EqDC> oracleCosts; // Computed for every node on the first request
 
     virtual void initialize(int stage) override;
+    void extractNetwork();
+    void computeOracleEqDC();
+    inet::Hz estimatePerNodeLoad() const;
+    inet::W getBackgroundNoisePower() const;
+    // Frame reception probability between the initiation radios at the SNIR given by the radio medium
+    double oracleLinkProbability(const inet::physicallayer::IRadio* transmitterRadio,
+            const inet::physicallayer::IRadio* receiverRadio, const inet::W noisePower) const;
     virtual inet::m computeMaxRange(const inet::Hz frequency, const double antennaGain, const inet::W maxTransmissionPower, const inet::W minReceptionPower) const;
 
     const ORWMacInterface* getFirstORWInterface(
             inet::IInterfaceTable *nodeInterfaces) const;
     inet::Hz computeAppTotalLoad(const cModule *nodeModule) const;
-    inet::unit computeHopsEstimate(const inet::Coord rootPosition, const inet::m maxRange, const Node *sourceNode) const;
-    inet::Hz computeNodeLoadContribution(const inet::Coord rootPosition, const Node* sourceNode, const inet::m maxRange) const;
-    EqDC estimatePerNodeEqDC(const inet::Coord rootPosition, const Node* node, const inet::Hz loadEstimate, const inet::m maxRange) const;
-    double computeNodeLoadContribution(Node* sourceNode, inet::Coord rootPosition, double maxRange) const;
+    inet::Coord getNearestHubPosition(const inet::Coord nodePosition) const;
+    inet::unit computeHopsEstimate(const inet::m maxRange, const Node *sourceNode) const;
+    inet::Hz computeNodeLoadContribution(const Node* sourceNode, const inet::m maxRange) const;
+    EqDC estimatePerNodeEqDC(const Node* node, const inet::Hz loadEstimate, const inet::m maxRange) const;
 };
 
 } /* namespace oppostack */
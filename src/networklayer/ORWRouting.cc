@@ -11,17 +11,31 @@
 #include <inet/networklayer/common/L3AddressTag_m.h>
 #include <inet/networklayer/common/L3AddressResolver.h>
 #include <inet/common/ProtocolGroup.h>
+#include <algorithm>
+#include <cmath>
 
 #include "common/oppDefs.h"
 #include "common/Units.h"
 #include "common/EqDCTag_m.h"
 #include "ORWRoutingTable.h"
+#include "EndToEndAck_m.h"
+#include "DisseminationManager.h"
+#ifdef OPPOSTACK_DELAY_TRACKING
+#include "statistics/PacketDelayTag_m.h"
+#endif
 
 using namespace oppostack;
 
 
 Define_Module(ORWRouting);
 simsignal_t ORWRouting::ForwPacketSentSignal = cComponent::registerSignal("ForwPacketSent");
+simsignal_t ORWRouting::endToEndAckedSignal = cComponent::registerSignal("endToEndAcked");
+simsignal_t ORWRouting::endToEndAckDelaySignal = cComponent::registerSignal("endToEndAckDelay");
+simsignal_t ORWRouting::endToEndRetransmissionSignal = cComponent::registerSignal("endToEndRetransmission");
+simsignal_t ORWRouting::endToEndGiveUpSignal = cComponent::registerSignal("endToEndGiveUp");
+simsignal_t ORWRouting::endToEndAckSentSignal = cComponent::registerSignal("endToEndAckSent");
+simsignal_t ORWRouting::routingLoopDetectedSignal = cComponent::registerSignal("routingLoopDetected");
+simsignal_t ORWRouting::datagramTooLargeSignal = cComponent::registerSignal("datagramTooLarge");
 
 const inet::Protocol oppostack::OpportunisticRouting("Opportunistic", "Opportunistic", Protocol::NetworkLayer);
 
@@ -34,6 +48,34 @@ void ORWRouting::initialize(int const stage) {
         routingTable = check_and_cast<ORWRoutingTable*>(routingTableModule);
         arp = inet::getModuleFromPar<IArp>(par("arpModule"), this);
         initialTTL = par("initialTTL");
+        adaptiveTTL = par("adaptiveTTL");
+        ttlHopFactor = par("ttlHopFactor");
+        ttlHopSlack = par("ttlHopSlack");
+        loopDetection = par("loopDetection");
+
+        retransmissionTimer = new cMessage("End-to-end Retransmission Timer");
+        endToEndAckTimer = new cMessage("End-to-end Ack Timer");
+        endToEndReliability = par("endToEndReliability");
+        retransmissionBufferCapacity = par("retransmissionBufferCapacity");
+        maxEndToEndTries = par("maxEndToEndTries");
+        endToEndTimeout = par("endToEndTimeout");
+        endToEndAckDelay = par("endToEndAckDelay");
+
+        reassemblyTimer = new cMessage("Reassembly Timeout");
+        fragmentation = par("fragmentation");
+        maxFragments = par("maxFragments");
+        reassemblyBufferCapacity = par("reassemblyBufferCapacity");
+        reassemblyTimeout = par("reassemblyTimeout");
+        if(maxFragments < 1 || maxFragments > 255){
+            throw cRuntimeError("maxFragments must be between 1 and 255");
+        }
+        if(endToEndReliability && !supportsDownwardRouting()){
+            throw cRuntimeError("endToEndReliability needs downward routing to return acknowledgements, use ORPLRouting");
+        }
+        const char* disseminationPath = par("disseminationModule");
+        if(*disseminationPath != '\0'){
+            dissemination = check_and_cast<DisseminationManager*>(getModuleByPath(disseminationPath));
+        }
     }
     else if (stage == INITSTAGE_NETWORK_CONFIGURATION){
         ProtocolGroup::ipprotocol.addProtocol(245, &OpportunisticRouting);
@@ -46,14 +88,32 @@ void ORWRouting::initialize(int const stage) {
         else
             throw cRuntimeError("No non-loopback interface found!");
 
-        const char* rootParameter = par("hubAddress");
-        L3AddressResolver().tryResolve(rootParameter, rootAddress, L3AddressResolver::ADDR_MODULEPATH);
+        // Default destination is the first hub, delivery happens at whichever hub is reached first
+        const auto hubs = ORWRoutingTable::resolveHubAddresses(par("hubAddress"));
+        if(!hubs.empty()){
+            rootAddress = hubs.front();
+        }
+
+        if(fragmentation){
+            // All fragments of a datagram are queued at the MAC at once
+            cModule* macQueue = ie->getSubmodule("mac") ? ie->getSubmodule("mac")->getSubmodule("queue") : nullptr;
+            if(macQueue != nullptr && macQueue->hasPar("packetCapacity")){
+                const int packetCapacity = macQueue->par("packetCapacity");
+                if(packetCapacity >= 0 && packetCapacity < maxFragments){
+                    EV_WARN << "MAC queue capacity " << packetCapacity << " is below maxFragments " << maxFragments
+                            << ", fragments of large datagrams will be dropped" << endl;
+                }
+            }
+        }
     }
 }
 
 inet::MacAddress ORWRouting::getOutboundMacAddress(const Packet* packet) const
 {
     auto header = packet->peekAtFront<OpportunisticRoutingHeader>();
+    if(header->getLinkLocal()){
+        return MacAddress::BROADCAST_ADDRESS;
+    }
     inet::L3Address destinationAddress = header->getDestAddr();
     if( not destinationAddress.isUnspecified()){
         auto ie = interfaceTable->findFirstNonLoopbackInterface();
@@ -63,18 +123,319 @@ inet::MacAddress ORWRouting::getOutboundMacAddress(const Packet* packet) const
 }
 
 void ORWRouting::handleUpperPacket(Packet* const packet) {
+#ifdef OPPOSTACK_DELAY_TRACKING
+    packet->addTagIfAbsent<MacTimingInd>()->setNetworkArrival(simTime());
+#endif
     auto addressReq = packet->addTagIfAbsent<L3AddressReq>();
     //TODO: check tags assigned by higher layer
-    if(addressReq->getDestAddress().getType() == L3Address::NONE){
+    if(addressReq->getDestAddress().getType() == L3Address::NONE && packet->findTag<LinkLocalReq>() == nullptr){
         addressReq->setDestAddress(rootAddress);
         EV_WARN << "ORPL, setting received packet address to default hub address" << endl;
     }
     encapsulate(packet);
-    auto outboundMacAddress = getOutboundMacAddress(packet);
-    EqDC nextHopCost = EqDC(25.5);
-    EqDC ownCost = routingTable->calculateUpwardsCost(rootAddress, nextHopCost);
-    setDownControlInfo(packet, outboundMacAddress, ownCost, nextHopCost);
-    sendDown(packet);
+    if(packet->peekAtFront<OpportunisticRoutingHeader>()->getAckRequest()){
+        bufferForRetransmission(packet);
+    }
+    sendEncapsulated(packet);
+}
+
+void ORWRouting::sendEncapsulated(Packet* const datagram)
+{
+    if(loopDetection){
+        // Record the cost at the time of (re)transmission
+        auto mutableHeader = datagram->removeAtFront<OpportunisticRoutingHeader>();
+        mutableHeader->setCostInd(ExpectedCost(routingTable->calculateUpwardsCost(rootAddress)));
+        datagram->insertAtFront(mutableHeader);
+    }
+    std::vector<Packet*> packets{datagram};
+    const B mtu = B(interfaceTable->findFirstNonLoopbackInterface()->getMtu());
+    if(fragmentation && datagram->getDataLength() > mtu){
+        packets = fragment(datagram, mtu - B(OpportunisticRoutingHeader::headerByteLength));
+        if(packets.empty())return;
+    }
+    for(auto packet : packets){
+        auto outboundMacAddress = getOutboundMacAddress(packet);
+        EqDC nextHopCost = EqDC(25.5);
+        EqDC ownCost = routingTable->calculateUpwardsCost(rootAddress, nextHopCost);
+        setDownControlInfo(packet, outboundMacAddress, ownCost, nextHopCost);
+        sendDown(packet);
+    }
+}
+
+std::vector<Packet*> ORWRouting::fragment(Packet* const datagram, const B fragmentPayloadLength)
+{
+    // Only pop the header once the datagram is known to be fragmented, a dropped one keeps it
+    const B payloadLength = datagram->getDataLength() - datagram->peekAtFront<OpportunisticRoutingHeader>()->getChunkLength();
+    const int fragmentCount = (payloadLength.get() + fragmentPayloadLength.get() - 1) / fragmentPayloadLength.get();
+    std::vector<Packet*> fragments;
+    if(fragmentCount > maxFragments){
+        EV_WARN << "Datagram of " << payloadLength << " needs " << fragmentCount << " fragments, over maxFragments" << endl;
+        emit(datagramTooLargeSignal, datagram);
+        PacketDropDetails details;
+        details.setReason(PacketDropReason::OTHER_PACKET_DROP);
+        emit(packetDroppedSignal, datagram, &details);
+        delete datagram;
+        return fragments;
+    }
+    auto header = datagram->popAtFront<OpportunisticRoutingHeader>();
+    for(int i = 0; i < fragmentCount; i++){
+        const B offset = fragmentPayloadLength * i;
+        const B length = std::min(fragmentPayloadLength, payloadLength - offset);
+        std::string name = std::string(datagram->getName()) + "-frag" + std::to_string(i);
+        auto fragment = new Packet(name.c_str(), datagram->peekDataAt(offset, length));
+        fragment->copyTags(*datagram);
+        auto fragmentHeader = staticPtrCast<OpportunisticRoutingHeader>(header->dupShared());
+        fragmentHeader->setFragmentCount(fragmentCount);
+        fragmentHeader->setFragmentIndex(i);
+        fragmentHeader->setLength(length + fragmentHeader->getChunkLength());
+        fragment->insertAtFront(fragmentHeader);
+        auto fragmentTag = fragment->addTagIfAbsent<FragmentReq>();
+        fragmentTag->setSource(header->getSrcAddr());
+        fragmentTag->setDatagramId(header->getId());
+        fragmentTag->setFragmentIndex(i);
+        if(i < fragmentCount - 1){
+            // Lets the MAC send the next fragment without another wake-up
+            fragment->addTag<FramePendingReq>();
+        }
+        fragments.push_back(fragment);
+    }
+    delete datagram;
+    return fragments;
+}
+
+Packet* ORWRouting::reassemble(Packet* const fragment)
+{
+    auto header = fragment->peekAtFront<OpportunisticRoutingHeader>();
+    auto entry = std::find_if(reassemblyBuffer.begin(), reassemblyBuffer.end(), [&header](const ReassemblyEntry& e){
+        return e.source == header->getSrcAddr() && e.id == header->getId();
+    });
+    if(entry == reassemblyBuffer.end()){
+        if(reassemblyBuffer.size() >= reassemblyBufferCapacity){
+            // Make room by dropping the oldest incomplete datagram
+            dropReassemblyEntry(reassemblyBuffer.front(), PacketDropReason::QUEUE_OVERFLOW);
+            reassemblyBuffer.pop_front();
+        }
+        ReassemblyEntry newEntry;
+        newEntry.source = header->getSrcAddr();
+        newEntry.id = header->getId();
+        newEntry.firstArrival = simTime();
+        newEntry.fragments.resize(header->getFragmentCount(), nullptr);
+        reassemblyBuffer.push_back(newEntry);
+        entry = reassemblyBuffer.end() - 1;
+        scheduleReassemblyTimer();
+    }
+    const int index = header->getFragmentIndex();
+    if(index >= (int)entry->fragments.size() || entry->fragments[index] != nullptr){
+        EV_WARN << "Inconsistent fragment " << index << " of datagram " << header->getId() << endl;
+        PacketDropDetails details;
+        details.setReason(PacketDropReason::OTHER_PACKET_DROP);
+        dropPacket(fragment, details);
+        return nullptr;
+    }
+    entry->fragments[index] = fragment;
+    entry->received++;
+    if(entry->received < (int)entry->fragments.size()){
+        return nullptr;
+    }
+
+    // All fragments received, rebuild the datagram behind the first fragment's header
+    auto datagramHeader = staticPtrCast<OpportunisticRoutingHeader>(
+            entry->fragments[0]->peekAtFront<OpportunisticRoutingHeader>()->dupShared());
+    std::string name = entry->fragments[0]->getName();
+    auto datagram = new Packet(name.substr(0, name.rfind("-frag")).c_str());
+    datagram->copyTags(*entry->fragments[0]);
+    for(auto part : entry->fragments){
+        part->popAtFront<OpportunisticRoutingHeader>();
+        datagram->insertAtBack(part->peekData());
+        delete part;
+    }
+    datagramHeader->setFragmentCount(1);
+    datagramHeader->setFragmentIndex(0);
+    datagramHeader->setLength(datagram->getDataLength() + datagramHeader->getChunkLength());
+    datagram->insertAtFront(datagramHeader);
+    reassemblyBuffer.erase(entry);
+    scheduleReassemblyTimer();
+    return datagram;
+}
+
+void ORWRouting::dropReassemblyEntry(ReassemblyEntry& entry, const PacketDropReason reason)
+{
+    for(auto& part : entry.fragments){
+        if(part != nullptr){
+            PacketDropDetails details;
+            details.setReason(reason);
+            dropPacket(part, details);
+            part = nullptr;
+        }
+    }
+}
+
+void ORWRouting::scheduleReassemblyTimer()
+{
+    cancelEvent(reassemblyTimer);
+    if(!reassemblyBuffer.empty()){
+        scheduleAt(reassemblyBuffer.front().firstArrival + reassemblyTimeout, reassemblyTimer);
+    }
+}
+
+void ORWRouting::dropExpiredReassembly()
+{
+    while(!reassemblyBuffer.empty() && reassemblyBuffer.front().firstArrival + reassemblyTimeout <= simTime()){
+        dropReassemblyEntry(reassemblyBuffer.front(), PacketDropReason::LIFETIME_EXPIRED);
+        reassemblyBuffer.pop_front();
+    }
+    scheduleReassemblyTimer();
+}
+
+bool ORWRouting::allFragmentsKnown(const Ptr<const OpportunisticRoutingHeader>& header)
+{
+    oppostack::PacketRecord record;
+    record.setSource(header->getSourceAddress());
+    for(int i = 0; i < header->getFragmentCount(); i++){
+        record.setSeqNo(header->getId() | (uint32_t)i << 16);
+        if(!messageKnown(record))return false;
+    }
+    return true;
+}
+
+void ORWRouting::bufferForRetransmission(const Packet* packet)
+{
+    if(retransmissionBuffer.size() >= retransmissionBufferCapacity){
+        // Make room by giving up on the oldest packet
+        auto& oldest = retransmissionBuffer.front();
+        emit(endToEndGiveUpSignal, oldest.packet);
+        delete oldest.packet;
+        retransmissionBuffer.pop_front();
+    }
+    RetransmissionEntry entry;
+    entry.packet = packet->dup();
+    entry.firstSent = simTime();
+    entry.lastSent = simTime();
+    retransmissionBuffer.push_back(entry);
+    scheduleRetransmissionTimer();
+}
+
+void ORWRouting::scheduleRetransmissionTimer()
+{
+    cancelEvent(retransmissionTimer);
+    if(retransmissionBuffer.empty())return;
+    simtime_t nextDeadline = SimTime::getMaxTime();
+    for(const auto& entry : retransmissionBuffer){
+        // Timeout doubles after each retransmission
+        const simtime_t deadline = entry.lastSent + endToEndTimeout * (1 << (entry.transmissions - 1));
+        nextDeadline = std::min(nextDeadline, deadline);
+    }
+    scheduleAt(std::max(nextDeadline, simTime()), retransmissionTimer);
+}
+
+void ORWRouting::retransmitExpired()
+{
+    for(auto entry = retransmissionBuffer.begin(); entry != retransmissionBuffer.end();){
+        const simtime_t deadline = entry->lastSent + endToEndTimeout * (1 << (entry->transmissions - 1));
+        if(deadline > simTime()){
+            entry++;
+        }
+        else if(entry->transmissions >= maxEndToEndTries){
+            emit(endToEndGiveUpSignal, entry->packet);
+            delete entry->packet;
+            entry = retransmissionBuffer.erase(entry);
+        }
+        else{
+            entry->transmissions++;
+            entry->lastSent = simTime();
+            // Routing cost may have changed since the first attempt
+            auto packet = entry->packet->dup();
+            emit(endToEndRetransmissionSignal, packet);
+            sendEncapsulated(packet);
+            entry++;
+        }
+    }
+    scheduleRetransmissionTimer();
+}
+
+void ORWRouting::processEndToEndAck(const L3Address& destination, Packet* const packet)
+{
+    packet->popAtFront<OpportunisticRoutingHeader>();
+    const auto ack = packet->peekAtFront<EndToEndAck>();
+    EV_DETAIL << "End-to-end ack from " << destination << " up to id " << ack->getHighestId() << endl;
+    for(auto entry = retransmissionBuffer.begin(); entry != retransmissionBuffer.end();){
+        const auto entryHeader = entry->packet->peekAtFront<OpportunisticRoutingHeader>();
+        // Only packets sent to the acknowledging destination match, any hub acknowledges for the anycast root
+        const L3Address entryDestination = entryHeader->getDestAddr();
+        const bool sameDestination = entryDestination == destination
+                || (routingTable->isHubAddress(entryDestination) && routingTable->isHubAddress(destination));
+        const uint16_t behind = ack->getHighestId() - entryHeader->getId();
+        const bool acknowledged = sameDestination && (behind == 0
+                || (behind <= 32 && (ack->getReceivedHistory() >> (behind - 1)) & 1));
+        if(acknowledged){
+            emit(endToEndAckedSignal, entry->packet);
+            emit(endToEndAckDelaySignal, simTime() - entry->firstSent);
+            delete entry->packet;
+            entry = retransmissionBuffer.erase(entry);
+        }
+        else{
+            entry++;
+        }
+    }
+    delete packet;
+    scheduleRetransmissionTimer();
+}
+
+void ORWRouting::recordEndToEndReception(const Ptr<const OpportunisticRoutingHeader>& header)
+{
+    if(!supportsDownwardRouting())return; // No way back to the source
+    const uint16_t id = header->getId();
+    auto existing = endToEndReceived.find(header->getSrcAddr());
+    if(existing == endToEndReceived.end()){
+        endToEndReceived[header->getSrcAddr()].highestId = id;
+    }
+    else{
+        auto& state = existing->second;
+        const int16_t offset = static_cast<int16_t>(static_cast<uint16_t>(id - state.highestId));
+        if(offset > 0){
+            // Previous highest id becomes bit offset-1 of the history
+            const uint64_t history = offset > 32 ? 0 :
+                    ((uint64_t)state.receivedHistory << offset) | (1ULL << (offset - 1));
+            state.receivedHistory = (uint32_t)history;
+            state.highestId = id;
+        }
+        else if(offset < 0 && offset >= -32){
+            state.receivedHistory |= 1u << (-offset - 1);
+        }
+    }
+    // Duplicates are acknowledged again in case the previous ack was lost
+    endToEndReceived[header->getSrcAddr()].pendingAck = true;
+    if(!endToEndAckTimer->isScheduled()){
+        scheduleAt(simTime() + endToEndAckDelay, endToEndAckTimer);
+    }
+}
+
+void ORWRouting::sendEndToEndAcks()
+{
+    for(auto& source : endToEndReceived){
+        if(!source.second.pendingAck)continue;
+        if(!isDownwardRoutable(source.first)){
+            EV_INFO << "No downward route to " << source.first << ", end-to-end ack waits for the next packet" << endl;
+            continue;
+        }
+        source.second.pendingAck = false;
+        const auto ack = makeShared<EndToEndAck>();
+        ack->setHighestId(source.second.highestId);
+        ack->setReceivedHistory(source.second.receivedHistory);
+        auto packet = new Packet("EndToEndAck", ack);
+        packet->addTag<L3AddressReq>()->setDestAddress(source.first);
+        packet->addTag<PacketProtocolTag>()->setProtocol(&OpportunisticRouting);
+        emit(endToEndAckSentSignal, packet);
+        handleUpperPacket(packet);
+    }
+}
+
+void ORWRouting::clearRetransmissionBuffer()
+{
+    for(auto& entry : retransmissionBuffer){
+        delete entry.packet;
+    }
+    retransmissionBuffer.clear();
 }
 
 void ORWRouting::advanceHeaderOneHop(const inet::Ptr<oppostack::OpportunisticRoutingHeader>& mutableHeader)
@@ -91,10 +452,16 @@ void ORWRouting::advanceHeaderOneHop(const inet::Ptr<oppostack::OpportunisticRou
 
 void ORWRouting::forwardPacket(EqDC ownCost, EqDC nextHopCost, Packet* const packet)
 {
+#ifdef OPPOSTACK_DELAY_TRACKING
+    // Timing of the previous hop is already recorded, start this hop afresh
+    packet->removeTagIfPresent<MacTimingInd>();
+    packet->addTag<MacTimingInd>()->setNetworkArrival(simTime());
+#endif
     // Update packet header before forwarding
     auto mutableHeader = packet->removeAtFront<OpportunisticRoutingHeader>();
     // Decrease TTL, set routing cost threshold and Forward.
     advanceHeaderOneHop(mutableHeader);
+    mutableHeader->setCostInd(ExpectedCost(ownCost));
     packet->insertAtFront(mutableHeader);
     auto outboundMacAddress = getOutboundMacAddress(packet);
     if (outboundMacAddress == MacAddress::UNSPECIFIED_ADDRESS) {
@@ -113,13 +480,28 @@ void ORWRouting::deduplicateAndDeliver(const inet::Ptr<const oppostack::Opportun
     // Check for duplicates
     oppostack::PacketRecord pktRecord;
     pktRecord.setSource(header->getSourceAddress());
-    pktRecord.setSeqNo(header->getId());
+    pktRecord.setSeqNo(fragmentSeqNo(header.get()));
     if (messageKnown(pktRecord)) {
+        if(header->isFragment() && header->getAckRequest() && allFragmentsKnown(header)){
+            // Retransmitted datagram was already reassembled, the ack was lost
+            recordEndToEndReception(header);
+        }
         // Don't deliver duplicates to higher levels
         PacketDropDetails details;
         details.setReason(PacketDropReason::DUPLICATE_DETECTED);
         dropPacket(packet, details);
     }
+    else if (header->isFragment()) {
+        packetHistory.insert(pktRecord);
+        Packet* datagram = reassemble(packet);
+        if(datagram != nullptr){
+            if(header->getAckRequest()){
+                recordEndToEndReception(datagram->peekAtFront<OpportunisticRoutingHeader>());
+            }
+            decapsulate(datagram);
+            sendUp(datagram);
+        }
+    }
     else {
         packetHistory.insert(pktRecord);
         decapsulate(packet);
@@ -128,20 +510,44 @@ void ORWRouting::deduplicateAndDeliver(const inet::Ptr<const oppostack::Opportun
 }
 
 void ORWRouting::handleLowerPacket(Packet* const packet) {
+    extractDisseminationSummary(packet);
     auto header = packet->peekAtFront<OpportunisticRoutingHeader>();
     auto const payloadLength = header->getLength() - header->getChunkLength();
-    inet::L3Address destinationAddress = header->getDestAddr();
-    EqDC nextHopCost = EqDC(25.5);
-    EqDC ownCost = routingTable->calculateUpwardsCost(destinationAddress, nextHopCost);
     if(payloadLength<B(1)){
         // No data contained so silently accept packet
         // This only occurs when OpportunisticRpl sends hello messages
         delete packet; // TODO: emit removedPacket signal as well
+        return;
+    }
+    else if (header->getLinkLocal()) {
+        // Meant for every neighbor that heard it, never forwarded
+        // The unspecified destination has no cost, so check before the lookup
+        deduplicateAndDeliver(header, packet);
+        return;
+    }
+    inet::L3Address destinationAddress = header->getDestAddr();
+    EqDC nextHopCost = EqDC(25.5);
+    EqDC ownCost = routingTable->calculateUpwardsCost(destinationAddress, nextHopCost);
+    if (ownCost == EqDC(0.0) && header->getEndToEndAck()) {
+        processEndToEndAck(header->getSrcAddr(), packet);
     }
     else if (ownCost == EqDC(0.0)) {
+        if(header->getAckRequest() && !header->isFragment()){
+            // Fragmented datagrams are acknowledged once reassembled
+            recordEndToEndReception(header);
+        }
         // Check for duplicates
         deduplicateAndDeliver(header, packet);
     }
+    else if(loopDetection && header->getIsUpwards() && ownCost >= EqDC(header->getCostInd())){
+        // No progress towards the hub since the last hop
+        EV_WARN << "Routing loop detected, own cost " << ownCost << " not below sender cost "
+                << EqDC(header->getCostInd()) << endl;
+        emit(routingLoopDetectedSignal, packet);
+        PacketDropDetails details;
+        details.setReason(PacketDropReason::OTHER_PACKET_DROP);
+        dropPacket(packet, details);
+    }
     else if(packet->findTag<EqDCReq>()!=nullptr || nextHopCost < EqDC(25.5)){
         // "trim" required to remove the popped headers from lower layers
         packet->trim();
@@ -180,14 +586,37 @@ void ORWRouting::encapsulate(Packet* const packet) {
     else{
         header->setProtocol(&Protocol::manet);
     }
+    header->setEndToEndAck(header->getProtocol() == &OpportunisticRouting);
+    header->setAckRequest(endToEndReliability && !header->getEndToEndAck()
+            && !header->getDestAddr().isUnspecified() && packet->findTag<EqDCBroadcast>() == nullptr);
+    header->setLinkLocal(packet->findTag<LinkLocalReq>() != nullptr);
     header->setSrcAddr(nodeAddress);
-    header->setTtl(initialTTL);
+    header->setTtl(header->getLinkLocal() ? 1 : computeInitialTtl(header->getDestAddr()));
     header->setVersion(IpProtocolId::IP_PROT_MANET);
     packet->insertAtFront(header);
 }
 
+uint8_t ORWRouting::computeInitialTtl(const L3Address& destination) const
+{
+    if(!adaptiveTTL || !routingTable->isHubAddress(destination)){
+        return initialTTL;
+    }
+    const double hopsEstimate = routingTable->getHopsToHubEstimate();
+    const EqDC estimatedCost = routingTable->getEstimatedEqDC();
+    const EqDC ownCost = routingTable->calculateUpwardsCost(destination);
+    if(hopsEstimate <= 0 || estimatedCost <= EqDC(0) || estimatedCost >= EqDC(25.5) || ownCost >= EqDC(25.5)){
+        return initialTTL;
+    }
+    // Invert the estimateEqDC() relation cost = 100*sqrt(hops)*(1 + 0.05/sqrt(DC)) - 60 at the learned cost,
+    // the duty cycle term is the one of the estimate, so hops scale with ((cost + 60)/(estimate + 60))^2
+    const double costRatio = (ExpectedCost(ownCost).get() + 60.0)/(ExpectedCost(estimatedCost).get() + 60.0);
+    const double hops = std::max(1.0, hopsEstimate * costRatio * costRatio);
+    return (uint8_t)std::min(255.0, std::ceil(hops * ttlHopFactor) + ttlHopSlack);
+}
+
 void ORWRouting::setDownControlInfo(Packet* const packet, const MacAddress& macMulticast, const EqDC& costIndicator, const EqDC& onwardCost) const
 {
+    addDisseminationSummary(packet);
     packet->addTagIfAbsent<MacAddressReq>()->setDestAddress(macMulticast);
     if(packet->findTag<EqDCReq>()==nullptr){
         packet->addTag<EqDCReq>()->setEqDC(onwardCost); // Set expected cost of any forwarder
@@ -197,6 +626,49 @@ void ORWRouting::setDownControlInfo(Packet* const packet, const MacAddress& macM
     packet->addTagIfAbsent<DispatchProtocolInd>()->setProtocol(&OpportunisticRouting);
 }
 
+void ORWRouting::addDisseminationSummary(Packet* const packet) const
+{
+    if(dissemination == nullptr || packet->findTag<EqDCBroadcast>() == nullptr){
+        return;
+    }
+    const auto header = packet->peekAtFront<OpportunisticRoutingHeader>();
+    if(header->getLength() > header->getChunkLength()){
+        // Only empty broadcasts such as hellos carry the summary
+        return;
+    }
+    auto summary = dissemination->buildSummary();
+    if(summary == nullptr){
+        return;
+    }
+    auto mutableHeader = packet->removeAtFront<OpportunisticRoutingHeader>();
+    auto mutableOptions = mutableHeader->getOptionsForUpdate();
+    mutableOptions.insertTlvOption(summary);
+    mutableHeader->setOptions(mutableOptions);
+    mutableHeader->setChunkLength(mutableHeader->calculateHeaderByteLength());
+    packet->insertAtFront(mutableHeader);
+    dissemination->notifySummaryPiggybacked();
+}
+
+void ORWRouting::extractDisseminationSummary(Packet* const packet) const
+{
+    const auto header = packet->peekAtFront<OpportunisticRoutingHeader>();
+    const int summaryId = header->getOptions().findByType(DisseminationSummaryExt::extType, 0);
+    if(summaryId == -1){
+        return;
+    }
+    // Remove the summary so the header length matches the payload again
+    auto mutableHeader = packet->removeAtFront<OpportunisticRoutingHeader>();
+    auto mutableOptions = mutableHeader->getOptionsForUpdate();
+    if(dissemination != nullptr){
+        dissemination->handleSummary(mutableHeader->getSrcAddr(),
+                check_and_cast<const DisseminationSummaryExt*>(mutableOptions.getTlvOption(summaryId)));
+    }
+    mutableOptions.eraseTlvOption(summaryId);
+    mutableHeader->setOptions(mutableOptions);
+    mutableHeader->setChunkLength(mutableHeader->calculateHeaderByteLength());
+    packet->insertAtFront(mutableHeader);
+}
+
 void ORWRouting::decapsulate(Packet* const packet) const
 {
     auto networkHeader = packet->popAtFront<OpportunisticRoutingHeader>();
@@ -256,6 +728,15 @@ void ORWRouting::handleSelfMessage(cMessage* const msg) {
             scheduleAt(simTime()+forwardingBackoff, nextForwardTimer);
         }
     }
+    else if(msg == retransmissionTimer){
+        retransmitExpired();
+    }
+    else if(msg == endToEndAckTimer){
+        sendEndToEndAcks();
+    }
+    else if(msg == reassemblyTimer){
+        dropExpiredReassembly();
+    }
 }
 
 void ORWRouting::handleStartOperation(LifecycleOperation *op) {
@@ -263,16 +744,34 @@ void ORWRouting::handleStartOperation(LifecycleOperation *op) {
         // send packet after scheduled timer
         scheduleAt(simTime()+forwardingBackoff, nextForwardTimer);
     }
+    scheduleRetransmissionTimer();
+    scheduleReassemblyTimer();
+    for(const auto& source : endToEndReceived){
+        if(source.second.pendingAck){
+            scheduleAt(simTime() + endToEndAckDelay, endToEndAckTimer);
+            break;
+        }
+    }
 }
 
 void ORWRouting::handleStopOperation(LifecycleOperation *op) {
     if(nextForwardTimer == nullptr)
         return;
     cancelEvent(nextForwardTimer);
+    cancelEvent(retransmissionTimer);
+    cancelEvent(endToEndAckTimer);
+    cancelEvent(reassemblyTimer);
 }
 
 void ORWRouting::handleCrashOperation(LifecycleOperation *op) {
     handleStopOperation(op);
+    // End-to-end state is held in volatile memory
+    clearRetransmissionBuffer();
+    endToEndReceived.clear();
+    for(auto& entry : reassemblyBuffer){
+        dropReassemblyEntry(entry, PacketDropReason::INTERFACE_DOWN);
+    }
+    reassemblyBuffer.clear();
 }
 
 bool ORWRouting::messageKnown(const oppostack::PacketRecord record)
@@ -283,6 +782,15 @@ bool ORWRouting::messageKnown(const oppostack::PacketRecord record)
 oppostack::ORWRouting::~ORWRouting()
 {
     cancelAndDelete(nextForwardTimer);
+    cancelAndDelete(retransmissionTimer);
+    cancelAndDelete(endToEndAckTimer);
+    cancelAndDelete(reassemblyTimer);
+    clearRetransmissionBuffer();
+    for(auto& entry : reassemblyBuffer){
+        for(auto part : entry.fragments){
+            delete part;
+        }
+    }
     if(waitingPacket != nullptr){
         delete waitingPacket;
         waitingPacket = nullptr;
@@ -18,47 +18,29 @@
 #include "OpportunisticRoutingHeader_m.h"
 #include <set>
 #include <map>
-#include <algorithm> // For std::find
+#include <deque>
+#include <vector>
 
+#include "common/OrderedDropHeadQueue.h"
 #include "common/Units.h"
 #include "ORWRoutingTable.h"
 
 namespace oppostack{
 
 extern const inet::Protocol OpportunisticRouting;
-
-template <class T>
-class OrderedDropHeadQueue{
-private:
-    std::deque<T> q;
-    unsigned int maxSize;
-public:
-    OrderedDropHeadQueue(int _size = 64):
-        q(_size), maxSize(_size){}
-
-    const typename std::deque<T>::const_iterator getIndex(const T& element) const{
-        return std::find(q.begin(),q.end(),element);
-    }
-    bool find(const T& element) const{
-        return getIndex(element) != q.end();
-    }
-
-    void insert(const T& element){
-        auto duplicate = getIndex(element);
-        if(duplicate!=q.end()){
-            q.erase(duplicate);
-        }
-        while(q.size()>=maxSize){
-            q.pop_front();
-        }
-        q.push_back(element);
-    }
-};
+class DisseminationManager;
 
 class ORWRouting : public inet::NetworkProtocolBase, public inet::INetworkProtocol{
 public:
 
     static omnetpp::simsignal_t ForwPacketSentSignal;
+    static omnetpp::simsignal_t endToEndAckedSignal;
+    static omnetpp::simsignal_t endToEndAckDelaySignal;
+    static omnetpp::simsignal_t endToEndRetransmissionSignal;
+    static omnetpp::simsignal_t endToEndGiveUpSignal;
+    static omnetpp::simsignal_t endToEndAckSentSignal;
+    static omnetpp::simsignal_t routingLoopDetectedSignal;
+    static omnetpp::simsignal_t datagramTooLargeSignal;
     ORWRouting()
         : NetworkProtocolBase(),
         nextForwardTimer(nullptr),
@@ -73,6 +55,11 @@ protected:
     // Crude net layer backoff to reduce contention of forwarded packets with multiple forwarders
     simtime_t forwardingBackoff;
     uint8_t initialTTL = 3; // Overwritten by NED
+    bool adaptiveTTL = false;
+    double ttlHopFactor = 2.0;
+    int ttlHopSlack = 2;
+    bool loopDetection = false;
+    uint8_t computeInitialTtl(const inet::L3Address& destination) const;
 
     ORWRoutingTable *routingTable; // TODO: Make IRoutingTable if features allow
     inet::IArp *arp;
@@ -87,6 +74,73 @@ protected:
     OrderedDropHeadQueue<oppostack::PacketRecord> packetHistory{2048};
     bool messageKnown(const oppostack::PacketRecord record);
 
+    // End-to-end reliability, sources buffer ackRequest packets until the destination acknowledges them
+    bool endToEndReliability = false;
+    class RetransmissionEntry{
+    public:
+        inet::Packet* packet; // Encapsulated copy before any per-hop control info
+        simtime_t firstSent;
+        simtime_t lastSent;
+        int transmissions = 1;
+    };
+    std::deque<RetransmissionEntry> retransmissionBuffer;
+    size_t retransmissionBufferCapacity = 16;
+    int maxEndToEndTries = 3;
+    simtime_t endToEndTimeout;
+    cMessage* retransmissionTimer{nullptr};
+    // Destination side, newest id and history of ids received from each source
+    class EndToEndReceiveState{
+    public:
+        uint16_t highestId = 0;
+        uint32_t receivedHistory = 0;
+        bool pendingAck = false;
+    };
+    std::map<inet::L3Address, EndToEndReceiveState> endToEndReceived;
+    simtime_t endToEndAckDelay;
+    cMessage* endToEndAckTimer{nullptr};
+
+    void bufferForRetransmission(const inet::Packet* packet);
+    void scheduleRetransmissionTimer();
+    void retransmitExpired();
+    void recordEndToEndReception(const inet::Ptr<const oppostack::OpportunisticRoutingHeader>& header);
+    void sendEndToEndAcks();
+    void processEndToEndAck(const inet::L3Address& destination, inet::Packet* packet);
+    void clearRetransmissionBuffer();
+    // ORWRouting alone has no route back to the source for acknowledgements
+    virtual bool supportsDownwardRouting() const {return false;};
+    virtual bool isDownwardRoutable(const inet::L3Address& destination) const {return false;};
+
+    // Fragmentation of datagrams above the interface MTU, reassembled at the destination
+    bool fragmentation = false;
+    int maxFragments = 8;
+    class ReassemblyEntry{
+    public:
+        inet::L3Address source;
+        uint16_t id;
+        simtime_t firstArrival;
+        std::vector<inet::Packet*> fragments;
+        int received = 0;
+    };
+    std::deque<ReassemblyEntry> reassemblyBuffer; // Oldest first
+    size_t reassemblyBufferCapacity = 4;
+    simtime_t reassemblyTimeout;
+    cMessage* reassemblyTimer{nullptr};
+    static uint32_t fragmentSeqNo(const oppostack::OpportunisticRoutingHeader* header){
+        return header->getId() | (uint32_t)header->getFragmentIndex() << 16;
+    };
+    void sendEncapsulated(inet::Packet* datagram);
+    std::vector<inet::Packet*> fragment(inet::Packet* datagram, const inet::B fragmentPayloadLength);
+    inet::Packet* reassemble(inet::Packet* fragment);
+    void dropReassemblyEntry(ReassemblyEntry& entry, const inet::PacketDropReason reason);
+    void scheduleReassemblyTimer();
+    void dropExpiredReassembly();
+    bool allFragmentsKnown(const inet::Ptr<const oppostack::OpportunisticRoutingHeader>& header);
+
+    // Optional dissemination, its summary rides on empty link-local broadcasts such as hellos
+    DisseminationManager* dissemination{nullptr};
+    void addDisseminationSummary(inet::Packet* packet) const;
+    void extractDisseminationSummary(inet::Packet* packet) const;
+
 
     virtual void encapsulate(inet::Packet* packet);
     virtual void decapsulate(inet::Packet* packet) const;
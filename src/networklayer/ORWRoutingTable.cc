@@ -8,6 +8,7 @@
 #include "common/EncounterDetails_m.h"
 #include <inet/networklayer/nexthop/NextHopInterfaceData.h>
 #include <inet/networklayer/common/L3AddressResolver.h>
+#include <inet/common/ModuleAccess.h>
 
 #include "../linklayer/ORWGram_m.h"
 #include "linklayer/ILinkOverhearingSource.h"
@@ -15,6 +16,9 @@
 #include "common/EqDCTag_m.h"
 #include "common/oppDefs.h"
 #include "ORWHello.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 
 using namespace omnetpp;
 using namespace inet;
@@ -24,6 +28,7 @@ Define_Module(ORWRoutingTable);
 simsignal_t ORWRoutingTable::updatedEqDCValueSignal = cComponent::registerSignal("updatedEqDCValue");
 simsignal_t ORWRoutingTable::vagueNeighborsSignal = cComponent::registerSignal("vagueNeighbors");
 simsignal_t ORWRoutingTable::sureNeighborsSignal = cComponent::registerSignal("sureNeighbors");
+simsignal_t ORWRoutingTable::neighborhoodChangedSignal = cComponent::registerSignal("neighborhoodChanged");
 
 void ORWRoutingTable::initialize(int stage){
     RoutingTableBase::initialize(stage);
@@ -36,12 +41,163 @@ void ORWRoutingTable::initialize(int stage){
         arp = inet::getModuleFromPar<IArp>(par("arpModule"), this);
 
         probCalcEncountersThresholdMax = par("probCalcEncountersThresholdMax");
+        neighborhoodChangeThreshold = EqDC(par("neighborhoodChangeThreshold"));
+        energyHeadroomPenalty = EqDC(par("energyHeadroomPenalty"));
     }
     else if(stage == INITSTAGE_NETWORK_LAYER){
-        const char* rootParameter = par("hubAddress");
-        L3AddressResolver().tryResolve(rootParameter, rootAddress, L3AddressResolver::ADDR_MODULEPATH);
+        const auto hubs = resolveHubAddresses(par("hubAddress"));
+        if(!hubs.empty()){
+            rootAddress = hubs.front();
+        }
+        // An unresolved hub leaves rootAddress unspecified, still a valid destination as before
+        hubAddresses.insert(rootAddress);
+        hubAddresses.insert(hubs.begin(), hubs.end());
+
+        if(par("loadRoutingState")){
+            loadRoutingState();
+        }
+    }
+}
+
+std::vector<L3Address> ORWRoutingTable::resolveHubAddresses(const char* hubAddressList)
+{
+    std::vector<L3Address> hubs;
+    cStringTokenizer tokenizer(hubAddressList);
+    while(tokenizer.hasMoreTokens()){
+        const char* token = tokenizer.nextToken();
+        L3Address hubAddress;
+        if(L3AddressResolver().tryResolve(token, hubAddress, L3AddressResolver::ADDR_MODULEPATH)){
+            hubs.push_back(hubAddress);
+        }
+        else{
+            EV_WARN << "Hub address " << token << " not resolved, ignoring" << endl;
+        }
+    }
+    return hubs;
+}
+
+void ORWRoutingTable::finish()
+{
+    if(par("saveRoutingState")){
+        saveRoutingState();
+    }
+}
+
+std::string ORWRoutingTable::getRoutingStateFileName() const
+{
+    const std::string dir = par("routingStateDir").stdstringValue();
+    return dir + "/" + getContainingNode(this)->getFullPath() + ".state";
+}
+
+void ORWRoutingTable::saveRoutingState() const
+{
+    const std::string dir = par("routingStateDir").stdstringValue();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if(ec){
+        throw cRuntimeError("Cannot create routing state directory \"%s\": %s", dir.c_str(), ec.message().c_str());
+    }
+    const std::string fileName = getRoutingStateFileName();
+    std::ofstream file(fileName);
+    if(!file){
+        throw cRuntimeError("Cannot write routing state file \"%s\"", fileName.c_str());
+    }
+    writeRoutingState(file);
+}
+
+void ORWRoutingTable::loadRoutingState()
+{
+    const std::string fileName = getRoutingStateFileName();
+    std::ifstream file(fileName);
+    if(!file){
+        EV_WARN << "No routing state at " << fileName << ", starting from an empty table" << endl;
+        return;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while(std::getline(file, line)){
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string type;
+        if(!(fields >> type) || type[0] == '#'){
+            continue;
+        }
+        if(!readRoutingStateRecord(type, fields)){
+            throw cRuntimeError("Malformed routing state file \"%s\" at line %d", fileName.c_str(), lineNumber);
+        }
+    }
+    EV_INFO << "Loaded routing state from " << fileName << ", cost to root "
+            << calculateUpwardsCost(rootAddress) << endl;
+    emit(updatedEqDCValueSignal, calculateUpwardsCost(rootAddress).get());
+}
+
+void ORWRoutingTable::writeRoutingState(std::ostream& os) const
+{
+    os << "# routing state of " << getContainingNode(this)->getFullPath() << " at " << simTime() << "\n";
+    os << "threshold " << probCalcEncountersThreshold << "\n";
+    writeNeighborRecords(os, "e", encountersTable);
+}
 
+bool ORWRoutingTable::readRoutingStateRecord(const std::string& type, std::istream& fields)
+{
+    if(type == "threshold"){
+        return (bool)(fields >> probCalcEncountersThreshold);
+    }
+    else if(type == "e"){
+        return readNeighborRecord(fields, encountersTable);
     }
+    return false;
+}
+
+std::map<L3Address, std::string> ORWRoutingTable::hostPathsByAddress()
+{
+    std::map<L3Address, std::string> hostPaths;
+    L3AddressResolver resolver;
+    for(cModule::SubmoduleIterator it(getSimulation()->getSystemModule()); !it.end(); ++it){
+        IInterfaceTable* interfaces = resolver.findInterfaceTableOf(*it);
+        if(interfaces == nullptr){
+            continue;
+        }
+        for(int i = 0; i < interfaces->getNumInterfaces(); i++){
+            const L3Address address = interfaces->getInterface(i)->getNetworkAddress();
+            if(!address.isUnspecified()){
+                hostPaths.emplace(address, (*it)->getFullPath());
+            }
+        }
+    }
+    return hostPaths;
+}
+
+void ORWRoutingTable::writeNeighborRecords(std::ostream& os, const char* type, const NeighbourRecords& records)
+{
+    // Addresses are not stable between runs, so neighbors are keyed by host path
+    const auto hostPaths = hostPathsByAddress();
+    for(const auto& record : records){
+        const auto hostPath = hostPaths.find(record.first);
+        if(hostPath == hostPaths.end()){
+            continue;
+        }
+        os << type << " " << hostPath->second << " " << record.second.lastEqDC.get()
+                << " " << record.second.recentInteractionProb << " " << record.second.interactionsTotal << "\n";
+    }
+}
+
+bool ORWRoutingTable::readNeighborRecord(std::istream& fields, NeighbourRecords& records)
+{
+    std::string hostPath;
+    double lastEqDC, recentInteractionProb, interactionsTotal;
+    if(!(fields >> hostPath >> lastEqDC >> recentInteractionProb >> interactionsTotal)){
+        return false;
+    }
+    L3Address address;
+    if(!L3AddressResolver().tryResolve(hostPath.c_str(), address, L3AddressResolver::ADDR_MODULEPATH)){
+        EV_WARN << "Routing state neighbor " << hostPath << " not in network, ignored" << endl;
+        return true;
+    }
+    records[address].lastEqDC = EqDC(lastEqDC);
+    records[address].recentInteractionProb = recentInteractionProb;
+    records[address].interactionsTotal = interactionsTotal;
+    return true;
 }
 
 void ORWRoutingTable::receiveSignal(cComponent* source, simsignal_t signalID, double weight, cObject* details)
@@ -60,6 +216,11 @@ void ORWRoutingTable::updateEncounters(const L3Address address, const oppostack:
 {
     // Update encounters table entry. Optionally adding if it doesn't exist
     const EqDC oldEqDC = calculateUpwardsCost(rootAddress);
+    const auto existingEntry = encountersTable.find(address);
+    if(existingEntry == encountersTable.end()
+            || std::abs((existingEntry->second.lastEqDC - cost).get()) >= neighborhoodChangeThreshold.get()){
+        emit(neighborhoodChangedSignal, cost.get());
+    }
     if(cost!=encountersTable[address].lastEqDC){
         encountersTable[address].lastEqDC = cost;
         if(cost<oldEqDC){
@@ -73,41 +234,16 @@ void ORWRoutingTable::updateEncounters(const L3Address address, const oppostack:
 
 EqDC ORWRoutingTable::calculateCostToRoot() const
 {
-    typedef std::pair<EqDC, double> EncPair;
-    std::vector<EncPair> neighborEncounterPairs;
-    for (const auto& entry : encountersTable) {
-        // Copy pairs to sortable vector
-        const EncPair encounterPair(entry.second.lastEqDC, entry.second.recentInteractionProb);
-        neighborEncounterPairs.push_back(encounterPair);
-    }
-    // Sort neighborEncounterPairs increasing on EqDC
-    std::sort(neighborEncounterPairs.begin(), neighborEncounterPairs.end(), [](const EncPair &left, const EncPair &right) {
-        return left.first < right.first;
-        });
-    double probSum = 0.0;
-    EqDC probProductSum = EqDC(0.0);
-    EqDC estimatedCostLessW = EqDC(25.5);
-    for (const auto& entry : neighborEncounterPairs) {
-        // Check if in forwarding set
-        if (entry.first <= estimatedCostLessW) {
-            probSum += entry.second;
-            probProductSum += entry.second * entry.first;
-            if (probSum > 0) {
-                estimatedCostLessW = (EqDC(1.0) + probProductSum) / probSum;
-            }
-            else {
-                estimatedCostLessW = EqDC(25.5);
-            }
-        }
-        else {
-            break;
-        }
-    }
-    // Set initial values of EqDC to aid startup
-    if (probSum == 0) {
-        estimatedCostLessW = ExpectedCost(par("hubExpectedCost"));
-    }
-    return estimatedCostLessW;
+    // Initial value of EqDC from hubExpectedCost aids startup
+    auto startupCost = [this](){return EqDC(ExpectedCost(par("hubExpectedCost")));};
+    return routing::costToRoot(encountersTable, startupCost, EqDC(25.5), costToRootPairs);
+}
+
+bool ORWRoutingTable::isLocalDestination(const inet::L3Address& destination) const
+{
+    // Upward traffic is anycast, any hub delivers packets to a hub address
+    return RoutingTableBase::isLocalDestination(destination)
+            || (isHubAddress(destination) && isHubAddress(interfaceTable->findFirstNonLoopbackInterface()->getNetworkAddress()));
 }
 
 EqDC ORWRoutingTable::calculateUpwardsCost(const inet::L3Address destination) const
@@ -117,9 +253,13 @@ EqDC ORWRoutingTable::calculateUpwardsCost(const inet::L3Address destination) co
     if(interface->getNetworkAddress() == destination){
         return EqDC(0.0);
     }
-    else if(destination != rootAddress){
+    else if(!isHubAddress(destination)){
         throw cRuntimeError("Routing error, unknown graph root");
     }
+    else if(isHubAddress(interface->getNetworkAddress())){
+        // Upward traffic is anycast, any hub is a sink
+        return EqDC(0.0);
+    }
     return ExpectedCost(std::min(calculateCostToRoot() + forwardingCostW, EqDC(25.5)));
 }
 
@@ -193,7 +333,13 @@ INetfilter::IHook::Result ORWRoutingTable::datagramPreRoutingHook(Packet* datagr
             return IHook::Result::ACCEPT;
         }
         else if(header->getUpwards() == true){
-            if(upwardsCostToRoot<=costHeader->getMinExpectedCost()){
+            // Nodes low on energy only accept when clearly better than required
+            EqDC acceptanceCost = upwardsCostToRoot;
+            auto headroomInd = datagram->findTag<EnergyHeadroomInd>();
+            if(headroomInd != nullptr){
+                acceptanceCost += energyHeadroomPenalty*(1 - headroomInd->getHeadroom());
+            }
+            if(acceptanceCost<=costHeader->getMinExpectedCost()){
                 datagram->addTagIfAbsent<EqDCReq>()->setEqDC(upwardsCostToRoot);
                 //TODO: Check OpportunisticRoutingHeader for further forwarding confirmation
                 return IHook::Result::ACCEPT;
@@ -13,8 +13,14 @@
 #include <inet/networklayer/contract/IInterfaceTable.h>
 #include <inet/networklayer/contract/INetfilter.h>
 #include <inet/common/Units.h>
+#include <iostream>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "RoutingTableBase.h"
+#include "RoutingAlgorithms.h"
 
 namespace oppostack{
 
@@ -33,7 +39,8 @@ protected:
         double recentInteractionProb = 0;
         double interactionsTotal = 0;
     };
-    inet::L3Address rootAddress;
+    inet::L3Address rootAddress; // First of hubAddresses, packets addressed to it are delivered at any hub
+    std::set<inet::L3Address> hubAddresses;
     typedef std::map<inet::L3Address, NeighborEntry> NeighbourRecords;
     NeighbourRecords encountersTable;
     int encountersCount = 0;
@@ -44,12 +51,34 @@ protected:
     static omnetpp::simsignal_t updatedEqDCValueSignal;
     static omnetpp::simsignal_t vagueNeighborsSignal;
     static omnetpp::simsignal_t sureNeighborsSignal;
+    EqDC neighborhoodChangeThreshold = EqDC(1.0);
+    EqDC energyHeadroomPenalty = EqDC(0.0);
     void increaseInteractionDenominator();
     EqDC calculateCostToRoot() const;
+    // Reused by calculateCostToRoot() to avoid allocating on every cost query
+    mutable routing::CostProbabilityPairs<EqDC> costToRootPairs;
     virtual void activateWarmUpRoutingData();
     virtual inet::Hz estAdvertismentRate() override;
+    virtual void finish() override;
+
+    // Warm start checkpoint of the learned tables, see routingStateDir
+    std::string getRoutingStateFileName() const;
+    void saveRoutingState() const;
+    void loadRoutingState();
+    virtual void writeRoutingState(std::ostream& os) const;
+    // Returns false if the record type is not known
+    virtual bool readRoutingStateRecord(const std::string& type, std::istream& fields);
+    static std::map<inet::L3Address, std::string> hostPathsByAddress();
+    static void writeNeighborRecords(std::ostream& os, const char* type, const NeighbourRecords& records);
+    static bool readNeighborRecord(std::istream& fields, NeighbourRecords& records);
 
 public:
+    static omnetpp::simsignal_t neighborhoodChangedSignal;
+    // Resolve a space separated list of hub addresses, in list order
+    static std::vector<inet::L3Address> resolveHubAddresses(const char* hubAddressList);
+    // Hubs form a single anycast root with zero cost
+    bool isHubAddress(const inet::L3Address& address) const {return hubAddresses.find(address) != hubAddresses.end();};
+    virtual bool isLocalDestination(const inet::L3Address& destination) const override;
     using RoutingTableBase::calculateUpwardsCost;
     virtual oppostack::EqDC calculateUpwardsCost(const inet::L3Address destination) const override;
     virtual inet::INetfilter::IHook::Result datagramPreRoutingHook(inet::Packet *datagram) override;
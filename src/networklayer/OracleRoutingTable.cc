@@ -0,0 +1,69 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include <inet/common/ModuleAccess.h>
+
+#include "OracleRoutingTable.h"
+#include "ORWNetworkConfigurator.h"
+
+using namespace omnetpp;
+using namespace inet;
+using namespace oppostack;
+
+Define_Module(OracleRoutingTable);
+simsignal_t OracleRoutingTable::oracleGapSignal = cComponent::registerSignal("oracleGap");
+simsignal_t OracleRoutingTable::oracleModelErrorSignal = cComponent::registerSignal("oracleModelError");
+
+void OracleRoutingTable::initialize(int stage){
+    ORWRoutingTable::initialize(stage);
+    if(stage == INITSTAGE_LOCAL){
+        useOracleCost = par("useOracleCost");
+        configurator = check_and_cast<ORWNetworkConfigurator*>(getModuleByPath(par("configuratorModule")));
+    }
+    else if(stage == INITSTAGE_NETWORK_LAYER){
+        // Topology and addresses are complete after INITSTAGE_NETWORK_CONFIGURATION
+        oracleEqDC = ExpectedCost(configurator->getOracleEqDC(getContainingNode(this)));
+        EV_INFO << "Oracle EqDC " << oracleEqDC << endl;
+    }
+}
+
+bool OracleRoutingTable::isHub() const
+{
+    return isHubAddress(interfaceTable->findFirstNonLoopbackInterface()->getNetworkAddress());
+}
+
+EqDC OracleRoutingTable::calculateUpwardsCost(const inet::L3Address destination) const
+{
+    Enter_Method("OracleRoutingTable::calculateUpwardsCost(address)");
+    if(!useOracleCost){
+        return ORWRoutingTable::calculateUpwardsCost(destination);
+    }
+    const NetworkInterface* interface = interfaceTable->findFirstNonLoopbackInterface();
+    if(interface->getNetworkAddress() == destination){
+        return EqDC(0.0);
+    }
+    else if(!isHubAddress(destination)){
+        throw cRuntimeError("Routing error, unknown graph root");
+    }
+    else if(isHub()){
+        return EqDC(0.0);
+    }
+    return oracleEqDC;
+}
+
+void OracleRoutingTable::calculateInteractionProbability()
+{
+    ORWRoutingTable::calculateInteractionProbability();
+    if(!isHub()){
+        // Learned cost as ORWRoutingTable would advertise it
+        const EqDC learnedEqDC = ExpectedCost(std::min(calculateCostToRoot() + forwardingCostW, EqDC(25.5)));
+        const double gap = (learnedEqDC - oracleEqDC).get();
+        emit(oracleGapSignal, gap);
+        if(gap < 0){
+            // The learned cost cannot beat the optimum, so the oracle link or duty cycle model is off
+            emit(oracleModelErrorSignal, -gap);
+        }
+    }
+}
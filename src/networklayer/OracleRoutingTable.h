@@ -0,0 +1,39 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef NETWORKLAYER_ORACLEROUTINGTABLE_H_
+#define NETWORKLAYER_ORACLEROUTINGTABLE_H_
+
+#include "ORWRoutingTable.h"
+
+namespace oppostack{
+
+class ORWNetworkConfigurator;
+
+/**
+ * Routing table advertising the optimal EqDC computed by ORWNetworkConfigurator
+ * from global knowledge of node positions, link reception ratios and duty cycles.
+ * The ORW tables are still learned, and oracleGap records how far the learned
+ * cost is from the oracle as a benchmark for protocol changes.
+ */
+class OracleRoutingTable : public ORWRoutingTable{
+public:
+    virtual void initialize(int stage) override;
+    using RoutingTableBase::calculateUpwardsCost;
+    virtual oppostack::EqDC calculateUpwardsCost(const inet::L3Address destination) const override;
+protected:
+    ORWNetworkConfigurator* configurator{nullptr};
+    EqDC oracleEqDC = EqDC(25.5);
+    bool useOracleCost{true};
+    static omnetpp::simsignal_t oracleGapSignal;
+    static omnetpp::simsignal_t oracleModelErrorSignal;
+
+    virtual void calculateInteractionProbability() override;
+    bool isHub() const;
+};
+
+} //namespace oppostack
+
+#endif /* NETWORKLAYER_ORACLEROUTINGTABLE_H_ */
@@ -0,0 +1,159 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef NETWORKLAYER_ROUTINGALGORITHMS_H_
+#define NETWORKLAYER_ROUTINGALGORITHMS_H_
+
+// Core routing table algorithms, templated over the cost type and the neighbor
+// records map so they run without the simulation kernel (see benchmarks/).
+// Records map an address to an entry with lastEqDC, recentInteractionProb
+// and interactionsTotal members, like ORWRoutingTable::NeighborEntry.
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace oppostack{
+namespace routing{
+
+// Scratch storage kept by the caller so repeated cost calculations don't reallocate
+template<typename Cost>
+using CostProbabilityPairs = std::vector<std::pair<Cost, double>>;
+
+// ORW expected duty cycles to the root, excluding the forwarding cost.
+// Neighbors join the forwarding set in increasing cost while their cost is
+// not above the estimate so far. startupCost() is used when no neighbor
+// has an interaction probability yet.
+template<typename Cost, typename Records, typename StartupCost>
+Cost costToRoot(const Records& records, StartupCost startupCost, const Cost unreachableCost,
+        CostProbabilityPairs<Cost>& neighborEncounterPairs)
+{
+    typedef std::pair<Cost, double> EncPair;
+    neighborEncounterPairs.clear();
+    for (const auto& entry : records) {
+        // Copy pairs to sortable vector
+        neighborEncounterPairs.emplace_back(entry.second.lastEqDC, entry.second.recentInteractionProb);
+    }
+    // Sort neighborEncounterPairs increasing on EqDC
+    std::sort(neighborEncounterPairs.begin(), neighborEncounterPairs.end(), [](const EncPair &left, const EncPair &right) {
+        return left.first < right.first;
+        });
+    double probSum = 0.0;
+    Cost probProductSum = Cost(0.0);
+    Cost estimatedCostLessW = unreachableCost;
+    for (const auto& entry : neighborEncounterPairs) {
+        // Check if in forwarding set
+        if (entry.first <= estimatedCostLessW) {
+            probSum += entry.second;
+            probProductSum += entry.second * entry.first;
+            if (probSum > 0) {
+                estimatedCostLessW = (Cost(1.0) + probProductSum) / probSum;
+            }
+            else {
+                estimatedCostLessW = unreachableCost;
+            }
+        }
+        else {
+            break;
+        }
+    }
+    // Set initial values of EqDC to aid startup
+    if (probSum == 0) {
+        estimatedCostLessW = startupCost();
+    }
+    return estimatedCostLessW;
+}
+
+// Number of active downward nodes, counting nodes in both tables once
+template<typename Cost, typename Records>
+int countDownwardNodes(const Records& routingSet, const Records& encounters, const Cost ownEqDCEstimate)
+{
+    int downwardsSetSize = 0;
+
+    // Utility functions
+    auto isNeighborEntryActive = [](const auto& node)
+        {return node.recentInteractionProb > 0;};
+    auto isNeighborEntryDownwards = [&](const auto& node)
+        {return node.lastEqDC >= ownEqDCEstimate;};
+
+    // Loop through merged downward set from neighbour
+    for (const auto& nodePair : routingSet) {
+        const auto& nodeEntry = nodePair.second;
+        // Only count active downward routing set entries
+        if (isNeighborEntryActive(nodeEntry) && isNeighborEntryDownwards(nodeEntry)) {
+            auto encountersTblRes = encounters.find(nodePair.first);
+            if (encountersTblRes == encounters.end() || !isNeighborEntryActive(encountersTblRes->second)) {
+                // Node not an active immediate neighbor so count from routing set
+                downwardsSetSize++;
+            }
+        }
+    }
+    // loop through encountersTable
+    for (const auto& nodePair : encounters) {
+        const auto& node = nodePair.second;
+        if (isNeighborEntryActive(node) && isNeighborEntryDownwards(node)) {
+            downwardsSetSize++;
+        }
+    }
+    return downwardsSetSize;
+}
+
+// Cost of routing downwards to destination: one hop for an active downward
+// neighbor, two for a node in the merged routing set, otherwise unreachable
+template<typename Cost, typename Records, typename Address>
+Cost downwardsCost(const Records& routingSet, const Records& encounters, const Address& destination,
+        const Cost ownEqDCEstimate, const Cost hopCost, const Cost unreachableCost)
+{
+    // TODO: Clarify if checking both recentInteractionProb and node.interactionsTotal is problematic
+    // When is recentInteractionProb == 0 but interactionsTotal > 2
+    auto isNeighborEntryActive = [](const auto& node)
+        {return node.recentInteractionProb > 0 || node.interactionsTotal > 2;};
+
+    const auto immediateNeighbor = encounters.find(destination);
+    if(immediateNeighbor != encounters.end() && isNeighborEntryActive(immediateNeighbor->second)
+            && immediateNeighbor->second.lastEqDC >= ownEqDCEstimate){
+        return hopCost;
+    }
+    const auto downwardsSetNode = routingSet.find(destination);
+    if(downwardsSetNode != routingSet.end() && isNeighborEntryActive(downwardsSetNode->second)){
+        return 2.0*hopCost;
+    }
+    return unreachableCost;
+}
+
+// Split the active entries of both tables into the routing set shared with
+// neighbors and the excluded set. Routing set entries are classified first.
+// Returns the number of addresses found in both sets (potential loops).
+template<typename Records, typename Address, typename IsDownwards>
+int sharingRoutingSet(const Records& routingSet, const Records& encounters, IsDownwards isDownwards,
+        std::set<Address>& sharingSet, std::set<Address>& excludedSet)
+{
+    int conflicts = 0;
+    auto classify = [&](const Records& records){
+        for (const auto& nodePair : records) {
+            if (!(nodePair.second.recentInteractionProb > 0)) {
+                continue;
+            }
+            if (isDownwards(nodePair.second.lastEqDC)) {
+                sharingSet.insert(nodePair.first);
+                conflicts += excludedSet.count(nodePair.first);
+            }
+            else {
+                // Exclude neighbor from sharing set as not downwards
+                excludedSet.insert(nodePair.first);
+                conflicts += sharingSet.count(nodePair.first);
+            }
+        }
+    };
+    classify(routingSet);
+    classify(encounters);
+    return conflicts;
+}
+
+} //namespace routing
+} //namespace oppostack
+
+#endif /* NETWORKLAYER_ROUTINGALGORITHMS_H_ */
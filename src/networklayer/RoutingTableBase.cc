@@ -66,6 +66,11 @@ L3Address RoutingTableBase::getRouterIdAsGeneric() {
     return interfaceTable->findFirstNonLoopbackInterface()->getNetworkAddress();
 }
 
+bool RoutingTableBase::isLocalDestination(const L3Address& destination) const
+{
+    return interfaceTable->findInterfaceByAddress(destination) != nullptr;
+}
+
 EqDC RoutingTableBase::calculateUpwardsCost(const L3Address destination, EqDC& nextHopEqDC) const
 {
     Enter_Method("RoutingTableBase::calculateUpwardsCost(address, ..)");
@@ -83,7 +88,7 @@ Hz RoutingTableBase::estAdvertismentRate() {
     return Hz{0};
 }
 
-EqDC RoutingTableBase::estimateEqDC(const Hz expectedLoad, const unit hopsToSink){
+unit RoutingTableBase::estimateDutyCycle(const Hz expectedLoad){
     auto energyManager = check_and_cast<SimpleEpEnergyManagement*>(getModuleByPath("^.^.energyManagement"));
     auto energyGenerator = check_and_cast<IEpEnergyGenerator*>(getModuleByPath("^.^.energyGenerator"));
     auto P_EH = energyGenerator->getPowerGeneration();
@@ -126,10 +131,15 @@ EqDC RoutingTableBase::estimateEqDC(const Hz expectedLoad, const unit hopsToSink
         TOn = nextTOn;
     }
     const unit computedDC = TOn/(TOn+TOff);
-    const unit DC_est = computedDC<unit(1)? computedDC : unit(1);
+    return computedDC<unit(1)? computedDC : unit(1);
+}
+
+EqDC RoutingTableBase::estimateEqDC(const Hz expectedLoad, const unit hopsToSink){
+    const unit DC_est = estimateDutyCycle(expectedLoad);
     const ExpectedCost EqDC_initial{ 100.0*sqrt( hopsToSink.get() )*( 1.0 + 0.05/std::sqrt(DC_est.get()) )-60.0 };
     cPar& expectedCostPar = this->par("hubExpectedCost");
     const cValue newExpectedCost = cValue(EqDC_initial.get(), "ExpectedCost");
     expectedCostPar.setValue(newExpectedCost);
+    par("hopsToHubEstimate").setDoubleValue(hopsToSink.get());
     return EqDC_initial;
 }
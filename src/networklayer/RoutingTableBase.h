@@ -33,7 +33,14 @@ public:
 
     virtual oppostack::EqDC calculateUpwardsCost(const inet::L3Address destination, oppostack::EqDC& nextHopEqDC) const;
     virtual oppostack::EqDC calculateUpwardsCost(const inet::L3Address destination) const = 0;
+    // Packets to the destination are delivered at this node
+    virtual bool isLocalDestination(const inet::L3Address& destination) const;
     virtual EqDC estimateEqDC(const inet::Hz expectedLoad, const inet::unit hopsToSink);
+    // Fraction of time the node is on, from its energy budget and harvesting, under the expected load
+    inet::unit estimateDutyCycle(const inet::Hz expectedLoad);
+    // Hops to the hub and the matching initial cost, as estimated by the network configurator
+    double getHopsToHubEstimate() const {return par("hopsToHubEstimate");};
+    EqDC getEstimatedEqDC() const {return EqDC(ExpectedCost(par("hubExpectedCost")));};
 
     // Hook to accept incoming requests
     using inet::NetfilterBase::HookBase::datagramPreRoutingHook;
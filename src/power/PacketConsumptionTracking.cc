@@ -82,7 +82,9 @@ INetfilter::IHook::Result PacketConsumptionTracking::datagramLocalInHook(Packet*
         EV_ERROR << "Missing HopConsumptionTag at received node" << endl;
     }
     // If packet is at the destination, reportReception cost to destination to forwarding and source nodes
-    if(networkHeader->getDestAddr() == routingTable->getRouterIdAsGeneric()){
+    // Delivered at the destination, including anycast to any hub
+    // Link-local packets have no route to report and no cost for their unspecified destination
+    if(!networkHeader->getLinkLocal() && routingTable->isLocalDestination(networkHeader->getDestAddr())){
         // Log energy consumed for packet with reportReception() at each source component
         const size_t hops = packetTag->getSourceArraySize();
         ASSERT(hops == packetTag->getEnergyConsumedArraySize() && hops == packetTag->getEnergyConsumedArraySize());
@@ -105,7 +107,8 @@ INetfilter::IHook::Result PacketConsumptionTracking::datagramLocalOutHook(Packet
     auto tag = networkHeader->addTag<HopConsumptionTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength)); // Must error if tag exists (undef. behaviour)
     tag->setEnergyConsumed(J(0.0)); // Dummy Value, will be overwritten in postRoutingHook
     tag->setSource(this);
-    tag->setEstimatedCost(routingTable->calculateUpwardsCost(networkHeader->getDestAddr()));
+    // Link-local packets are delivered by the first hop
+    tag->setEstimatedCost(networkHeader->getLinkLocal() ? EqDC(0.0) : routingTable->calculateUpwardsCost(networkHeader->getDestAddr()));
     datagram->insertAtFront(networkHeader);
     return IHook::Result::ACCEPT;
 }
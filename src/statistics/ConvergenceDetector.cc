@@ -0,0 +1,233 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "ConvergenceDetector.h"
+#include <cmath>
+#include <cstring>
+
+using namespace omnetpp;
+
+namespace oppostack {
+
+Define_Module(ConvergenceDetector);
+
+void ConvergenceDetector::Series::addSample(const double sample)
+{
+    batchSum += sample;
+    if(++batchSamples == batchSize){
+        batchMeans.push_back(batchSum / batchSize);
+        batchSum = 0;
+        batchSamples = 0;
+    }
+}
+
+int ConvergenceDetector::mserTruncation(const std::vector<double>& batchMeans)
+{
+    const int n = batchMeans.size();
+    // Sums over the batches kept after truncating d, accumulated from the end
+    double sum = 0;
+    double sumSquares = 0;
+    double minMser = INFINITY;
+    int truncation = 0;
+    for(int d = n - 1; d >= 0; d--){
+        sum += batchMeans[d];
+        sumSquares += batchMeans[d] * batchMeans[d];
+        const int kept = n - d;
+        if(d > n / 2){
+            continue;
+        }
+        const double mser = (sumSquares - sum * sum / kept) / ((double)kept * kept);
+        if(mser <= minMser){
+            minMser = mser;
+            truncation = d;
+        }
+    }
+    return truncation;
+}
+
+double ConvergenceDetector::confidenceHalfWidth(const std::vector<double>& batchMeans)
+{
+    const int n = batchMeans.size();
+    if(n < 2){
+        return INFINITY;
+    }
+    double sum = 0;
+    double sumSquares = 0;
+    for(const double mean : batchMeans){
+        sum += mean;
+        sumSquares += mean * mean;
+    }
+    const double variance = std::max(0.0, (sumSquares - sum * sum / n) / (n - 1));
+    // Student t quantile from the Cornish-Fisher expansion around the normal one
+    const double z = 1.959964;
+    const double dof = n - 1;
+    const double t = z + (z*z*z + z) / (4 * dof) + (5*pow(z, 5) + 16*z*z*z + 3*z) / (96 * dof * dof);
+    return t * sqrt(variance / n);
+}
+
+void ConvergenceDetector::initialize()
+{
+    if(getSimulation()->getWarmupPeriod() <= 0)
+        throw cRuntimeError("ConvergenceDetector needs a warmup-period, used as the upper bound of the detected one");
+    sampleInterval = par("sampleInterval");
+    minBatches = par("minBatches");
+    relativePrecision = par("relativePrecision");
+    trafficModuleName = par("trafficModuleName").stdstringValue();
+    if(minBatches < 2)
+        throw cRuntimeError("minBatches must be at least 2");
+
+    cModule* network = getSimulation()->getSystemModule();
+    cStringTokenizer stateSignals(par("stateSignals"));
+    while(stateSignals.hasMoreTokens()){
+        const char* signalName = stateSignals.nextToken();
+        const simsignal_t signal = registerSignal(signalName);
+        lastValues[signal];
+        network->subscribe(signal, this);
+    }
+    if(par("trackDeliveryRatio")){
+        packetSentSignal = registerSignal("packetSent");
+        packetReceivedSignal = registerSignal("packetReceived");
+        network->subscribe(packetSentSignal, this);
+        network->subscribe(packetReceivedSignal, this);
+    }
+    cStringTokenizer precisionNames(par("precisionSeries"));
+    while(precisionNames.hasMoreTokens()){
+        precisionSeries.insert(precisionNames.nextToken());
+    }
+
+    sampleTimer = new cMessage("convergence sample timer");
+    scheduleAt(simTime() + sampleInterval, sampleTimer);
+}
+
+void ConvergenceDetector::receiveSignal(cComponent* source, simsignal_t signalID, intval_t value, cObject* details)
+{
+    receiveSignal(source, signalID, (double)value, details);
+}
+
+void ConvergenceDetector::receiveSignal(cComponent* source, simsignal_t signalID, double value, cObject* details)
+{
+    auto signalValues = lastValues.find(signalID);
+    if(signalValues != lastValues.end()){
+        signalValues->second[source->getId()] = value;
+    }
+}
+
+void ConvergenceDetector::receiveSignal(cComponent* source, simsignal_t signalID, cObject* value, cObject* details)
+{
+    // Application packets only, hellos and other control traffic also emit packetSent
+    if(strcmp(source->getName(), trafficModuleName.c_str()) != 0){
+        return;
+    }
+    if(signalID == packetSentSignal){
+        packetsSent++;
+    }
+    else if(signalID == packetReceivedSignal){
+        packetsReceived++;
+    }
+}
+
+void ConvergenceDetector::handleMessage(cMessage* msg)
+{
+    ASSERT(msg == sampleTimer);
+    sample();
+    if(!steadyState && detectSteadyState()){
+        steadyState = true;
+        if(simTime() < getSimulation()->getWarmupPeriod()){
+            getSimulation()->setWarmupPeriod(simTime());
+        }
+        EV_INFO << "Steady state detected, collecting results from " << getSimulation()->getWarmupPeriod() << endl;
+        // Confidence intervals only use batches from the steady state
+        for(auto& entry : series){
+            entry.second.batchMeans.clear();
+            entry.second.batchSum = 0;
+            entry.second.batchSamples = 0;
+        }
+    }
+    else if(steadyState && !precisionSeries.empty() && relativePrecision > 0 && isPrecisionReached()){
+        precisionReached = true;
+        EV_INFO << "Confidence intervals reached relativePrecision, ending the run" << endl;
+        endSimulation();
+    }
+    scheduleAt(simTime() + sampleInterval, sampleTimer);
+}
+
+void ConvergenceDetector::sample()
+{
+    for(const auto& signalValues : lastValues){
+        if(signalValues.second.empty()){
+            // Not emitted in this network, e.g. ORPL signals with ORW routing
+            continue;
+        }
+        double sum = 0;
+        for(const auto& value : signalValues.second){
+            sum += value.second;
+        }
+        series[getSignalName(signalValues.first)].addSample(sum / signalValues.second.size());
+    }
+    if(packetsSent > 0){
+        series["deliveryRatio"].addSample((double)packetsReceived / packetsSent);
+    }
+    packetsSent = 0;
+    packetsReceived = 0;
+}
+
+bool ConvergenceDetector::detectSteadyState()
+{
+    if(series.empty()){
+        return false;
+    }
+    bool detected = true;
+    for(auto& entry : series){
+        Series& tracked = entry.second;
+        const int n = tracked.batchMeans.size();
+        if(n < minBatches){
+            return false;
+        }
+        const int truncation = mserTruncation(tracked.batchMeans);
+        tracked.truncation = sampleInterval * (truncation * batchSize);
+        // A minimum at the end of the searched half means the transient may continue
+        detected = detected && truncation < n / 2;
+    }
+    return detected;
+}
+
+bool ConvergenceDetector::isPrecisionReached() const
+{
+    for(const auto& name : precisionSeries){
+        const auto entry = series.find(name);
+        if(entry == series.end() || (int)entry->second.batchMeans.size() < minBatches){
+            return false;
+        }
+        const auto& batchMeans = entry->second.batchMeans;
+        double mean = 0;
+        for(const double batchMean : batchMeans){
+            mean += batchMean;
+        }
+        mean /= batchMeans.size();
+        if(mean == 0 || confidenceHalfWidth(batchMeans) > relativePrecision * fabs(mean)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void ConvergenceDetector::finish()
+{
+    recordScalar("steadyStateDetected", steadyState);
+    recordScalar("warmupPeriod", getSimulation()->getWarmupPeriod(), "s");
+    recordScalar("precisionReached", precisionReached);
+    for(const auto& entry : series){
+        if(entry.second.truncation >= 0){
+            recordScalar((entry.first + ":mserTruncation").c_str(), entry.second.truncation, "s");
+        }
+    }
+}
+
+ConvergenceDetector::~ConvergenceDetector()
+{
+    cancelAndDelete(sampleTimer);
+}
+
+} /* namespace oppostack */
@@ -0,0 +1,77 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_CONVERGENCEDETECTOR_H_
+#define STATISTICS_CONVERGENCEDETECTOR_H_
+
+#include <omnetpp.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace oppostack {
+
+/**
+ * Detects the end of the routing startup transient from network wide series
+ * (mean of the nodes' last updatedEqDCValue, delivery ratio, ...) sampled
+ * every sampleInterval, with the MSER-5 truncation rule. Result collection
+ * starts at detection by lowering the warmup period, the configured
+ * warmup-period is the upper bound. Optionally ends the run once the
+ * confidence intervals of the precisionSeries are narrow enough.
+ */
+class ConvergenceDetector : public omnetpp::cSimpleModule, public omnetpp::cListener
+{
+  public:
+    // MSER-5 batch size, in samples
+    static const int batchSize = 5;
+    // Truncation point in batches minimising the MSER statistic, searched over the first half
+    static int mserTruncation(const std::vector<double>& batchMeans);
+    // Half-width of the 95% confidence interval on the mean of independent batch means
+    static double confidenceHalfWidth(const std::vector<double>& batchMeans);
+
+  protected:
+    class Series{
+      public:
+        std::vector<double> batchMeans;
+        double batchSum{0};
+        int batchSamples{0};
+        omnetpp::simtime_t truncation{-1};
+        void addSample(const double sample);
+    };
+    std::map<std::string, Series> series;
+    // Last value of each state signal per emitting module
+    std::map<omnetpp::simsignal_t, std::map<int, double>> lastValues;
+    long packetsSent{0};
+    long packetsReceived{0};
+    std::string trafficModuleName;
+    omnetpp::simsignal_t packetSentSignal{-1};
+    omnetpp::simsignal_t packetReceivedSignal{-1};
+
+    omnetpp::simtime_t sampleInterval;
+    int minBatches{20};
+    std::set<std::string> precisionSeries;
+    double relativePrecision{0};
+    bool steadyState{false};
+    bool precisionReached{false};
+    omnetpp::cMessage* sampleTimer{nullptr};
+
+    virtual void initialize() override;
+    virtual void handleMessage(omnetpp::cMessage* msg) override;
+    virtual void finish() override;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, omnetpp::intval_t value, omnetpp::cObject* details) override;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, double value, omnetpp::cObject* details) override;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, omnetpp::cObject* value, omnetpp::cObject* details) override;
+
+    void sample();
+    bool detectSteadyState();
+    bool isPrecisionReached() const;
+  public:
+    ~ConvergenceDetector();
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_CONVERGENCEDETECTOR_H_ */
@@ -0,0 +1,61 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "DeliveryEnergyRecorder.h"
+#include <algorithm>
+
+using namespace omnetpp;
+
+namespace oppostack {
+
+Define_Module(DeliveryEnergyRecorder);
+
+void DeliveryEnergyRecorder::initialize()
+{
+    cModule* network = getSimulation()->getSystemModule();
+    powerConsumptionChangedSignal = registerSignal("powerConsumptionChanged");
+    deliverySignal = registerSignal(par("deliverySignal"));
+    network->subscribe(powerConsumptionChangedSignal, this);
+    network->subscribe(deliverySignal, this);
+}
+
+void DeliveryEnergyRecorder::accumulateEnergy()
+{
+    const simtime_t start = std::max(lastUpdate, getSimulation()->getWarmupPeriod());
+    if(simTime() > start){
+        energyConsumed += totalPowerConsumption*(simTime() - start).dbl();
+    }
+    lastUpdate = simTime();
+}
+
+void DeliveryEnergyRecorder::receiveSignal(cComponent* source, simsignal_t signalID, double value, cObject* details)
+{
+    if(signalID != powerConsumptionChangedSignal){
+        return;
+    }
+    accumulateEnergy();
+    double& powerConsumption = powerConsumptions[source->getId()];
+    totalPowerConsumption += value - powerConsumption;
+    powerConsumption = value;
+}
+
+void DeliveryEnergyRecorder::receiveSignal(cComponent* source, simsignal_t signalID, cObject* value, cObject* details)
+{
+    if(signalID == deliverySignal && simTime() >= getSimulation()->getWarmupPeriod()){
+        deliveries++;
+    }
+}
+
+void DeliveryEnergyRecorder::finish()
+{
+    accumulateEnergy();
+    recordScalar("energyConsumed", energyConsumed, "J");
+    recordScalar("deliveries", deliveries);
+    if(deliveries > 0){
+        recordScalar("energyPerDelivery", energyConsumed/deliveries, "J");
+    }
+}
+
+} /* namespace oppostack */
@@ -0,0 +1,42 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_DELIVERYENERGYRECORDER_H_
+#define STATISTICS_DELIVERYENERGYRECORDER_H_
+
+#include <omnetpp.h>
+#include <map>
+
+namespace oppostack {
+
+/**
+ * Records the energy consumed over all nodes per delivered packet, from the
+ * powerConsumptionChanged signals of every energy consumer in the network and
+ * the count of deliverySignal emissions (endToEndAcked by default). Both are
+ * taken after the warmup period, as the other recorded statistics.
+ */
+class DeliveryEnergyRecorder : public omnetpp::cSimpleModule, public omnetpp::cListener
+{
+  protected:
+    omnetpp::simsignal_t powerConsumptionChangedSignal{-1};
+    omnetpp::simsignal_t deliverySignal{-1};
+    // Last power consumption of each consumer, in W
+    std::map<int, double> powerConsumptions;
+    double totalPowerConsumption{0}; // W
+    double energyConsumed{0}; // J
+    omnetpp::simtime_t lastUpdate{0};
+    long deliveries{0};
+
+    virtual void initialize() override;
+    virtual void finish() override;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, double value, omnetpp::cObject* details) override;
+    virtual void receiveSignal(omnetpp::cComponent* source, omnetpp::simsignal_t signalID, omnetpp::cObject* value, omnetpp::cObject* details) override;
+
+    void accumulateEnergy();
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_DELIVERYENERGYRECORDER_H_ */
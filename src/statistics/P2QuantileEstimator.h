@@ -0,0 +1,105 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_P2QUANTILEESTIMATOR_H_
+#define STATISTICS_P2QUANTILEESTIMATOR_H_
+
+#include <algorithm>
+#include <cmath>
+
+namespace oppostack {
+
+// Constant memory streaming estimate of a single quantile using the P-square
+// algorithm (Jain and Chlamtac, 1985). Five markers track the minimum, the
+// maximum, the quantile and the midpoints either side of it, adjusting their
+// heights with piecewise parabolic interpolation as samples arrive.
+class P2QuantileEstimator
+{
+  private:
+    double quantile;
+    long count{0};
+    double heights[5]{};
+    double positions[5]{};
+    double desiredPositions[5]{};
+    double desiredIncrements[5]{};
+
+    double parabolic(int i, double d) const{
+        return heights[i] + d / (positions[i+1] - positions[i-1]) *
+                ((positions[i] - positions[i-1] + d) * (heights[i+1] - heights[i]) / (positions[i+1] - positions[i]) +
+                 (positions[i+1] - positions[i] - d) * (heights[i] - heights[i-1]) / (positions[i] - positions[i-1]));
+    }
+    double linear(int i, int d) const{
+        return heights[i] + d * (heights[i+d] - heights[i]) / (positions[i+d] - positions[i]);
+    }
+  public:
+    explicit P2QuantileEstimator(double quantile):
+        quantile(quantile),
+        positions{1, 2, 3, 4, 5},
+        desiredPositions{1, 1 + 2*quantile, 1 + 4*quantile, 3 + 2*quantile, 5},
+        desiredIncrements{0, quantile/2, quantile, (1 + quantile)/2, 1}{}
+
+    double getQuantile() const{return quantile;}
+    long getCount() const{return count;}
+
+    void collect(double value){
+        if(count < 5){
+            // Initial samples are kept sorted in the marker heights
+            heights[count++] = value;
+            std::sort(heights, heights + count);
+            return;
+        }
+        count++;
+        int k;
+        if(value < heights[0]){
+            heights[0] = value;
+            k = 0;
+        }
+        else if(value >= heights[4]){
+            heights[4] = value;
+            k = 3;
+        }
+        else{
+            k = std::upper_bound(heights + 1, heights + 4, value) - heights - 1;
+        }
+        for(int i = k + 1; i < 5; i++){
+            positions[i]++;
+        }
+        for(int i = 0; i < 5; i++){
+            desiredPositions[i] += desiredIncrements[i];
+        }
+        // Adjust the inner markers that have drifted from their desired positions
+        for(int i = 1; i < 4; i++){
+            const double drift = desiredPositions[i] - positions[i];
+            if((drift >= 1 && positions[i+1] - positions[i] > 1) ||
+                    (drift <= -1 && positions[i-1] - positions[i] < -1)){
+                const int d = drift > 0 ? 1 : -1;
+                const double candidate = parabolic(i, d);
+                if(heights[i-1] < candidate && candidate < heights[i+1]){
+                    heights[i] = candidate;
+                }
+                else{
+                    heights[i] = linear(i, d);
+                }
+                positions[i] += d;
+            }
+        }
+    }
+
+    // Current estimate, exact while fewer than five samples have been collected
+    double getEstimate() const{
+        if(count == 0){
+            return NAN;
+        }
+        if(count < 5){
+            const int index = std::min((long)std::lround(quantile * (count - 1)), count - 1);
+            return heights[index];
+        }
+        return heights[2];
+    }
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_P2QUANTILEESTIMATOR_H_ */
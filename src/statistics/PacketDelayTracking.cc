@@ -0,0 +1,148 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "common/oppDefs.h"
+#include "PacketDelayTracking.h"
+#include "networklayer/OpportunisticRoutingHeader_m.h"
+
+using namespace oppostack;
+using namespace inet;
+
+Define_Module(PacketDelayTracking);
+
+simsignal_t PacketDelayTracking::netQueueDelaySignal = cComponent::registerSignal("netQueueDelay");
+simsignal_t PacketDelayTracking::macQueueDelaySignal = cComponent::registerSignal("macQueueDelay");
+simsignal_t PacketDelayTracking::backoffDelaySignal = cComponent::registerSignal("backoffDelay");
+simsignal_t PacketDelayTracking::retryDelaySignal = cComponent::registerSignal("retryDelay");
+simsignal_t PacketDelayTracking::wakeUpDelaySignal = cComponent::registerSignal("wakeUpDelay");
+simsignal_t PacketDelayTracking::dataDelaySignal = cComponent::registerSignal("dataDelay");
+simsignal_t PacketDelayTracking::ackContentionDelaySignal = cComponent::registerSignal("ackContentionDelay");
+simsignal_t PacketDelayTracking::hopDelaySignal = cComponent::registerSignal("hopDelay");
+simsignal_t PacketDelayTracking::hopTxTriesSignal = cComponent::registerSignal("hopTxTries");
+simsignal_t PacketDelayTracking::hopCountSignal = cComponent::registerSignal("hopCount");
+
+void PacketDelayTracking::initialize()
+{
+#ifndef OPPOSTACK_DELAY_TRACKING
+    throw cRuntimeError("PacketDelayTracking requires a build with OPPOSTACK_DELAY_TRACKING, use make DELAY_TRACKING=1");
+#endif
+    routingTable = check_and_cast<RoutingTableBase*>(getCModuleFromPar(par("routingTable"), this));
+    macLayer = check_and_cast<ORWMac*>(getCModuleFromPar(par("wakeUpMacModule"),this));
+    macLayer->registerHook(0, this);
+}
+
+void PacketDelayTracking::accumulateHopTagToRoute(const Ptr<HopDelayTag>& hopTag, const Ptr<PacketDelayTag>& packetTag,
+        const MacTimingInd* receiverTiming) const
+{
+    const simtime_t dataReceived = receiverTiming != nullptr && receiverTiming->getDataReceived() >= 0 ?
+            receiverTiming->getDataReceived() : simTime();
+    // Without a wake-up radio all time before the data is backoff
+    const simtime_t wakeUpStarted = hopTag->getWakeUpStarted() >= hopTag->getMacDequeue() ?
+            hopTag->getWakeUpStarted() : hopTag->getDataStarted();
+    // Failed tries, and the delays between them, are retry time rather than backoff
+    const simtime_t firstTryStarted = hopTag->getFirstTryStarted() >= hopTag->getMacDequeue() ?
+            hopTag->getFirstTryStarted() : wakeUpStarted;
+    const simtime_t macArrival = hopTag->getMacArrival() >= 0 ? hopTag->getMacArrival() : hopTag->getMacDequeue();
+    const simtime_t networkArrival = hopTag->getNetworkArrival() >= 0 ? hopTag->getNetworkArrival() : macArrival;
+
+    packetTag->insertSource(hopTag->getSourceForUpdate());
+    packetTag->insertNetQueueDelay(macArrival - networkArrival);
+    packetTag->insertMacQueueDelay(hopTag->getMacDequeue() - macArrival);
+    packetTag->insertBackoffDelay(firstTryStarted - hopTag->getMacDequeue());
+    packetTag->insertRetryDelay(wakeUpStarted - firstTryStarted);
+    packetTag->insertWakeUpDelay(hopTag->getDataStarted() - wakeUpStarted);
+    packetTag->insertDataDelay(dataReceived - hopTag->getDataStarted());
+    packetTag->insertAckContentionDelay(simTime() - dataReceived);
+    packetTag->insertTxTries(hopTag->getTxTries());
+    packetTag->insertAckRounds(receiverTiming != nullptr ? receiverTiming->getAckRounds() : 0);
+}
+
+void PacketDelayTracking::reportDelivery(const Ptr<const PacketDelayTag>& packetTag)
+{
+    const size_t hops = packetTag->getSourceArraySize();
+    simtime_t netQueue, macQueue, backoff, retry, wakeUp, data, ackContention;
+    for(size_t i=0; i<hops; i++){
+        netQueue += packetTag->getNetQueueDelay(i);
+        macQueue += packetTag->getMacQueueDelay(i);
+        backoff += packetTag->getBackoffDelay(i);
+        retry += packetTag->getRetryDelay(i);
+        wakeUp += packetTag->getWakeUpDelay(i);
+        data += packetTag->getDataDelay(i);
+        ackContention += packetTag->getAckContentionDelay(i);
+        emit(hopDelaySignal, packetTag->getNetQueueDelay(i) + packetTag->getMacQueueDelay(i)
+                + packetTag->getBackoffDelay(i) + packetTag->getRetryDelay(i) + packetTag->getWakeUpDelay(i)
+                + packetTag->getDataDelay(i) + packetTag->getAckContentionDelay(i));
+        emit(hopTxTriesSignal, packetTag->getTxTries(i));
+    }
+    emit(netQueueDelaySignal, netQueue);
+    emit(macQueueDelaySignal, macQueue);
+    emit(backoffDelaySignal, backoff);
+    emit(retryDelaySignal, retry);
+    emit(wakeUpDelaySignal, wakeUp);
+    emit(dataDelaySignal, data);
+    emit(ackContentionDelaySignal, ackContention);
+    emit(hopCountSignal, (long)hops);
+}
+
+INetfilter::IHook::Result PacketDelayTracking::datagramLocalOutHook(Packet* datagram)
+{
+    // Called as the MAC takes the packet from its queue
+    const auto timing = datagram->findTag<MacTimingInd>();
+    auto networkHeader = datagram->removeAtFront<OpportunisticRoutingHeader>();
+    auto hopTag = networkHeader->addTagIfAbsent<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+    hopTag->setSource(this);
+    hopTag->setNetworkArrival(timing != nullptr ? timing->getNetworkArrival() : -1);
+    hopTag->setMacArrival(timing != nullptr ? timing->getMacArrival() : -1);
+    hopTag->setMacDequeue(simTime());
+    hopTag->setFirstTryStarted(-1);
+    hopTag->setWakeUpStarted(-1);
+    hopTag->setDataStarted(-1);
+    datagram->insertAtFront(networkHeader);
+    return IHook::Result::ACCEPT;
+}
+
+INetfilter::IHook::Result PacketDelayTracking::datagramPostRoutingHook(Packet* datagram)
+{
+    // Called as each data frame transmission starts
+    const auto timing = datagram->findTag<MacTimingInd>();
+    auto networkHeader = datagram->removeAtFront<OpportunisticRoutingHeader>();
+    if(networkHeader->findTag<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength)) != nullptr){
+        auto hopTag = networkHeader->addTagIfAbsent<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+        hopTag->setFirstTryStarted(timing != nullptr ? timing->getFirstTryStarted() : -1);
+        hopTag->setWakeUpStarted(timing != nullptr ? timing->getWakeUpStarted() : -1);
+        hopTag->setDataStarted(simTime());
+        hopTag->setTxTries(timing != nullptr ? timing->getTxTries() : 1);
+    }
+    else{
+        EV_ERROR << "Missing HopDelayTag at transmitting node" << endl;
+    }
+    datagram->insertAtFront(networkHeader);
+    return IHook::Result::ACCEPT;
+}
+
+INetfilter::IHook::Result PacketDelayTracking::datagramLocalInHook(Packet* datagram)
+{
+    // Called as the MAC passes the received packet up, after ack contention
+    const auto timing = datagram->findTag<MacTimingInd>();
+    auto networkHeader = datagram->removeAtFront<OpportunisticRoutingHeader>();
+    auto packetTag = networkHeader->addTagIfAbsent<PacketDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+    auto hopTagCheck = networkHeader->findTag<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+    if(hopTagCheck != nullptr && hopTagCheck->getDataStarted() >= 0){
+        // Get mutable tag that already exists
+        auto hopTag = networkHeader->addTagIfAbsent<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+        accumulateHopTagToRoute(hopTag, packetTag, timing.get());
+        networkHeader->removeTag<HopDelayTag>(B(0),B(OpportunisticRoutingHeader::headerByteLength));
+    }
+    else{
+        EV_ERROR << "Missing HopDelayTag at received node" << endl;
+    }
+    // Delivered at the destination, including anycast to any hub
+    // Link-local packets have no route to report and no cost for their unspecified destination
+    if(!networkHeader->getLinkLocal() && routingTable->isLocalDestination(networkHeader->getDestAddr())){
+        reportDelivery(packetTag);
+    }
+    datagram->insertAtFront(networkHeader);
+    return IHook::Result::ACCEPT;
+}
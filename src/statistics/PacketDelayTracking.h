@@ -0,0 +1,53 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_PACKETDELAYTRACKING_H_
+#define STATISTICS_PACKETDELAYTRACKING_H_
+
+#include <inet/networklayer/contract/INetfilter.h>
+
+#include "linklayer/ORWMac.h"
+#include "networklayer/RoutingTableBase.h"
+#include "PacketDelayTag_m.h"
+
+namespace oppostack {
+
+/**
+ * Breaks down the delay of each hop into network queueing, MAC queueing,
+ * backoff, failed tries, wake-up, data and ACK contention phases. Timestamps are only set
+ * when built with OPPOSTACK_DELAY_TRACKING (make DELAY_TRACKING=1).
+ */
+class PacketDelayTracking : public omnetpp::cSimpleModule, public inet::NetfilterBase::HookBase
+{
+public:
+    static simsignal_t netQueueDelaySignal;
+    static simsignal_t macQueueDelaySignal;
+    static simsignal_t backoffDelaySignal;
+    static simsignal_t retryDelaySignal;
+    static simsignal_t wakeUpDelaySignal;
+    static simsignal_t dataDelaySignal;
+    static simsignal_t ackContentionDelaySignal;
+    static simsignal_t hopDelaySignal;
+    static simsignal_t hopTxTriesSignal;
+    static simsignal_t hopCountSignal;
+protected:
+    virtual void initialize() override;
+    RoutingTableBase* routingTable{nullptr};
+    ORWMac* macLayer{nullptr};
+
+    void accumulateHopTagToRoute(const inet::Ptr<HopDelayTag>& hopTag, const inet::Ptr<PacketDelayTag>& packetTag,
+            const MacTimingInd* receiverTiming) const;
+    void reportDelivery(const inet::Ptr<const PacketDelayTag>& packetTag);
+public:
+    virtual inet::INetfilter::IHook::Result datagramPreRoutingHook(inet::Packet *datagram) override{return IHook::Result::ACCEPT;};
+    virtual inet::INetfilter::IHook::Result datagramForwardHook(inet::Packet*) override{return IHook::Result::ACCEPT;};
+    virtual inet::INetfilter::IHook::Result datagramPostRoutingHook(inet::Packet *datagram) override;
+    virtual inet::INetfilter::IHook::Result datagramLocalInHook(inet::Packet *datagram) override;
+    virtual inet::INetfilter::IHook::Result datagramLocalOutHook(inet::Packet *datagram) override;
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_PACKETDELAYTRACKING_H_ */
@@ -0,0 +1,112 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "SimulationPerformanceRecorder.h"
+#include <algorithm>
+#include <fstream>
+
+#if defined(_WIN32)
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace omnetpp;
+
+namespace oppostack {
+
+Define_Module(SimulationPerformanceRecorder);
+
+void SimulationPerformanceRecorder::initialize()
+{
+    startTime = std::chrono::steady_clock::now();
+    startEvent = getSimulation()->getEventNumber();
+}
+
+int SimulationPerformanceRecorder::countNetworkNodes() const
+{
+    int nodes = 0;
+    for(cModule::SubmoduleIterator it(getSimulation()->getSystemModule()); !it.end(); ++it){
+        if((*it)->getProperties()->getAsBool("networkNode")){
+            nodes++;
+        }
+    }
+    return nodes;
+}
+
+long SimulationPerformanceRecorder::getPeakResidentSetSize()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))){
+        return (long)counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0){
+        return 0;
+    }
+#if defined(__APPLE__)
+    return usage.ru_maxrss; // Already bytes
+#else
+    return usage.ru_maxrss * 1024L; // Kilobytes on Linux
+#endif
+#endif
+}
+
+void SimulationPerformanceRecorder::finish()
+{
+    const double wallClock = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    const eventnumber_t events = getSimulation()->getEventNumber() - startEvent;
+    const double eventsPerSecond = wallClock > 0 ? events / wallClock : 0.0;
+    const long peakRss = getPeakResidentSetSize();
+    int numNodes = par("numNodes");
+    if(numNodes < 0){
+        numNodes = countNetworkNodes();
+    }
+    recordScalar("wallClockTime", wallClock, "s");
+    recordScalar("events", events);
+    recordScalar("eventsPerSecond", eventsPerSecond);
+    recordScalar("peakResidentSetSize", peakRss, "B");
+    recordScalar("numNodes", numNodes);
+    // Fixed process overhead would dominate at small numbers of nodes
+    const double nodesRss = std::max(0.0, peakRss - par("baselineResidentSetSize").doubleValue());
+    if(numNodes > 0){
+        recordScalar("bytesPerNode", nodesRss / numNodes, "B");
+    }
+    const char* summaryFile = par("summaryFile");
+    if(*summaryFile != '\0'){
+        appendSummary(summaryFile, numNodes, wallClock, events, eventsPerSecond, peakRss, nodesRss);
+    }
+}
+
+void SimulationPerformanceRecorder::appendSummary(const char* fileName, int numNodes, double wallClock,
+        eventnumber_t events, double eventsPerSecond, long peakRss, double nodesRss) const
+{
+    bool writeHeader = !std::ifstream(fileName).good();
+    std::ofstream summary(fileName, std::ios::app);
+    if(!summary.is_open()){
+        EV_ERROR << "Cannot open benchmark summary file " << fileName << endl;
+        return;
+    }
+    if(writeHeader){
+        summary << "config,run,numNodes,simTime,wallClockTime,events,eventsPerSecond,peakResidentSetSize,bytesPerNode\n";
+    }
+    cConfigurationEx* config = getEnvir()->getConfigEx();
+    summary << config->getActiveConfigName() << ','
+            << config->getActiveRunNumber() << ','
+            << numNodes << ','
+            << simTime().dbl() << ','
+            << wallClock << ','
+            << events << ','
+            << eventsPerSecond << ','
+            << peakRss << ','
+            << (numNodes > 0 ? nodesRss / numNodes : 0.0) << '\n';
+}
+
+} /* namespace oppostack */
@@ -0,0 +1,32 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_SIMULATIONPERFORMANCERECORDER_H_
+#define STATISTICS_SIMULATIONPERFORMANCERECORDER_H_
+
+#include <omnetpp.h>
+#include <chrono>
+
+namespace oppostack {
+
+class SimulationPerformanceRecorder : public omnetpp::cSimpleModule
+{
+  protected:
+    std::chrono::steady_clock::time_point startTime;
+    omnetpp::eventnumber_t startEvent{0};
+
+    virtual void initialize() override;
+    virtual void finish() override;
+    virtual int countNetworkNodes() const;
+    virtual void appendSummary(const char* fileName, int numNodes, double wallClock,
+            omnetpp::eventnumber_t events, double eventsPerSecond, long peakRss, double nodesRss) const;
+  public:
+    // Peak resident set size of this process in bytes, 0 when unavailable
+    static long getPeakResidentSetSize();
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_SIMULATIONPERFORMANCERECORDER_H_ */
@@ -0,0 +1,107 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#include "StreamingStatistics.h"
+
+using namespace omnetpp;
+using namespace oppostack;
+
+Register_ResultRecorder("quantiles", P2QuantileRecorder);
+Register_ResultRecorder("ewma", EwmaRecorder);
+Register_ResultFilter("ewma", EwmaFilter);
+
+namespace {
+double readAlpha(cProperty* property){
+    if(property == nullptr || property->getNumValues("ewmaAlpha") == 0){
+        return 0.05;
+    }
+    const double alpha = atof(property->getValue("ewmaAlpha", 0));
+    if(alpha <= 0 || alpha > 1){
+        throw cRuntimeError("ewmaAlpha must be in (0,1], got %g", alpha);
+    }
+    return alpha;
+}
+} // namespace
+
+void P2QuantileRecorder::init(Context* ctx)
+{
+    cNumericResultRecorder::init(ctx);
+    std::vector<double> quantiles = {0.5, 0.9, 0.95, 0.99};
+    if(ctx->attrsProperty != nullptr && ctx->attrsProperty->getNumValues("quantiles") > 0){
+        quantiles.clear();
+        for(int i = 0; i < ctx->attrsProperty->getNumValues("quantiles"); i++){
+            quantiles.push_back(atof(ctx->attrsProperty->getValue("quantiles", i)));
+        }
+    }
+    for(const double quantile : quantiles){
+        if(quantile <= 0 || quantile >= 1){
+            throw cRuntimeError("Quantile for %s must be in (0,1), got %g", getStatisticName(), quantile);
+        }
+        estimators.emplace_back(quantile);
+    }
+}
+
+void P2QuantileRecorder::collect(simtime_t_cref t, double value, cObject* details)
+{
+    for(auto& estimator : estimators){
+        estimator.collect(value);
+    }
+}
+
+void P2QuantileRecorder::finish(cResultFilter* prev)
+{
+    for(const auto& estimator : estimators){
+        // e.g. "transmissionTries:p95"
+        const std::string name = opp_stringf("%s:p%g", getStatisticName(), estimator.getQuantile() * 100);
+        opp_string_map attributes = getStatisticAttributes();
+        attributes["quantile"] = opp_stringf("%g", estimator.getQuantile());
+        getEnvir()->recordScalar(getComponent(), name.c_str(), estimator.getEstimate(), &attributes);
+    }
+}
+
+std::string P2QuantileRecorder::str() const
+{
+    std::stringstream os;
+    for(const auto& estimator : estimators){
+        os << "p" << estimator.getQuantile() * 100 << "=" << estimator.getEstimate() << " ";
+    }
+    return os.str();
+}
+
+void EwmaRecorder::init(Context* ctx)
+{
+    cNumericResultRecorder::init(ctx);
+    alpha = readAlpha(ctx->attrsProperty);
+}
+
+void EwmaRecorder::collect(simtime_t_cref t, double value, cObject* details)
+{
+    average = std::isnan(average) ? value : alpha * value + (1 - alpha) * average;
+}
+
+void EwmaRecorder::finish(cResultFilter* prev)
+{
+    opp_string_map attributes = getStatisticAttributes();
+    attributes["ewmaAlpha"] = opp_stringf("%g", alpha);
+    getEnvir()->recordScalar(getComponent(), getResultName().c_str(), average, &attributes);
+}
+
+std::string EwmaRecorder::str() const
+{
+    return opp_stringf("ewma=%g", average);
+}
+
+void EwmaFilter::init(Context* ctx)
+{
+    cNumericResultFilter::init(ctx);
+    alpha = readAlpha(ctx->attrsProperty);
+}
+
+bool EwmaFilter::process(simtime_t& t, double& value, cObject* details)
+{
+    average = std::isnan(average) ? value : alpha * value + (1 - alpha) * average;
+    value = average;
+    return true;
+}
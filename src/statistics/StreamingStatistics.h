@@ -0,0 +1,56 @@
+/* Copyright (c) 2021, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later */
+
+#ifndef STATISTICS_STREAMINGSTATISTICS_H_
+#define STATISTICS_STREAMINGSTATISTICS_H_
+
+#include <omnetpp.h>
+#include <vector>
+#include "P2QuantileEstimator.h"
+
+namespace oppostack {
+
+// Records streaming quantile estimates of a statistic as scalars, in constant
+// memory per statistic. Select with "record=quantiles", the default
+// quantiles can be overridden with e.g. "quantiles=0.5,0.99" in @statistic
+class P2QuantileRecorder : public omnetpp::cNumericResultRecorder
+{
+  protected:
+    std::vector<P2QuantileEstimator> estimators;
+    virtual void collect(omnetpp::simtime_t_cref t, double value, omnetpp::cObject *details) override;
+  public:
+    virtual void init(Context *ctx) override;
+    virtual void finish(omnetpp::cResultFilter *prev) override;
+    virtual std::string str() const override;
+};
+
+// Records the final exponentially weighted moving average of a statistic,
+// smoothing factor set with "ewmaAlpha=0.05" in @statistic
+class EwmaRecorder : public omnetpp::cNumericResultRecorder
+{
+  protected:
+    double alpha{0.05};
+    double average{NAN};
+    virtual void collect(omnetpp::simtime_t_cref t, double value, omnetpp::cObject *details) override;
+  public:
+    virtual void init(Context *ctx) override;
+    virtual void finish(omnetpp::cResultFilter *prev) override;
+    virtual std::string str() const override;
+};
+
+// Filter form of the above, emits the running average with each value
+class EwmaFilter : public omnetpp::cNumericResultFilter
+{
+  protected:
+    double alpha{0.05};
+    double average{NAN};
+    virtual bool process(omnetpp::simtime_t& t, double& value, omnetpp::cObject *details) override;
+  public:
+    virtual void init(Context *ctx) override;
+};
+
+} /* namespace oppostack */
+
+#endif /* STATISTICS_STREAMINGSTATISTICS_H_ */